@@ -26,113 +26,284 @@
 #include <common/Protocol.hpp>
 #include <crossbow/logger.hpp>
 
+#include <cstring>
+
 using err_code = boost::system::error_code;
 
 namespace tpcc {
 
 template <Command C>
-void Client::execute(const typename Signature<C>::arguments &arg) {
-    auto now = Clock::now();
-    if (now > mEndTime) {
+void Client::execute(const typename Signature<C>::arguments &arg, decltype(Clock::now()) start) {
+    if (Clock::now() > mEndTime || mLoad.stopped) {
         // Time's up
         // benchmarking finished
-        mSocket.shutdown(Socket::shutdown_both);
-        mSocket.close();
+        stop();
         return;
     }
+    auto sequence = ++mSequence;
+    mExpired = false;
+    if (mWorkload.deadline > 0) {
+        // the server only checks the deadline between its steps, a transaction
+        // waiting on a slow storage node is bounded here
+        mDeadline.expires_from_now(std::chrono::milliseconds(mWorkload.deadline));
+        mDeadline.async_wait([this, start, sequence](const err_code& ec) {
+            if (ec || sequence != mSequence) return;
+            mExpired = true;
+            auto end = Clock::now();
+            mStats.record(C, Outcome::TIMED_OUT, start, end);
+            if (mRawLog) {
+                mLog.push_back(LogEntry{false, "Deadline exceeded", C, start, end});
+            }
+        });
+    }
     mCmds.execute<C>(
-      [this, now](const err_code &ec, typename Signature<C>::result result) {
+      [this, start](const err_code &ec, const ResultView<typename Signature<C>::result>& result) {
+          err_code ignored;
+          mDeadline.cancel(ignored);
+          ++mSequence;
           if (ec) {
               LOG_ERROR("Error: " + ec.message());
+              // the connection is unusable, do not leave the arrivals waiting on it
+              mBusy = false;
+              stop();
+              return;
+          }
+          if (mExpired) {
+              // already counted as timed out, the late response is dropped
+              next();
               return;
           }
           auto end = Clock::now();
-          if (!result.success) {
-              LOG_ERROR("Transaction unsuccessful [error = %1%]", result.error);
+          auto outcome = Outcome::COMMITTED;
+          if (result.timedOut()) {
+              outcome = Outcome::TIMED_OUT;
+          } else if (result.overloaded()) {
+              outcome = Outcome::REJECTED;
+          } else if (!result.success()) {
+              outcome = Outcome::ABORTED;
+              LOG_ERROR("Transaction unsuccessful [error = %1%]", result.error());
           }
-          mLog.push_back(LogEntry{result.success, result.error, C, now, end});
-          run();
+          mStats.record(C, outcome, start, end);
+          if (mRawLog) {
+              mLog.push_back(LogEntry{result.success(), result.error().str(), C, start, end});
+          }
+          next();
       },
       arg);
 }
 
-void Client::run() {
-    auto n = rnd.random<int>(1, 100);
-    if (n <= 4) {
-        StockLevelIn args;
-        args.w_id      = mCurrWarehouse;
-        args.d_id      = mCurrDistrict;
-        args.threshold = rnd.randomWithin<int32_t>(10, 20);
-        execute<Command::STOCK_LEVEL>(args);
+void Client::run(decltype(Clock::now()) endTime) {
+    mEndTime = endTime;
+    if (mReplay) {
+        if (mSchedule.empty()) {
+            stop();
+            return;
+        }
+        mReplayStart = Clock::now();
+        mNextArrival = mReplayStart + mSchedule[0];
+        mTimer.expires_at(mNextArrival);
+        mTimer.async_wait([this](const err_code& ec) {
+            if (ec) return;
+            arrive();
+        });
+        return;
+    }
+    if (mLoad.rate <= 0) {
+        doTransaction(Clock::now());
+        return;
+    }
+    mNextArrival = Clock::now();
+    arrive();
+}
+
+void Client::arrive() {
+    if (mNextArrival > mEndTime || mLoad.stopped) {
+        if (!mBusy) stop();
+        return;
+    }
+    // latency is measured from the intended send time, so transactions
+    // queueing behind a slow one are accounted for
+    mPending.push_back(mNextArrival);
+    if (mReplay && ++mScheduled == mSchedule.size()) {
+        // the replay is complete, stop once the last request returned
+        mArrivalsDone = true;
+        if (!mBusy) next();
+        return;
+    }
+    if (!mBusy) next();
+    mNextArrival = mReplay ? mReplayStart + mSchedule[mScheduled] : mNextArrival + interArrival();
+    mTimer.expires_at(mNextArrival);
+    mTimer.async_wait([this](const err_code& ec) {
+        if (ec) return;
+        arrive();
+    });
+}
+
+void Client::next() {
+    if (mLoad.rate <= 0 && !mReplay) {
+        doTransaction(Clock::now());
+        return;
+    }
+    if (mPending.empty()) {
+        mBusy = false;
+        // arrive() does not stop a busy client once the arrivals are over,
+        // so the last transaction to return has to
+        if (mArrivalsDone || Clock::now() > mEndTime || mLoad.stopped) stop();
+        return;
+    }
+    auto start = mPending.front();
+    mPending.pop_front();
+    mBusy = true;
+    doTransaction(start);
+}
+
+void Client::stop() {
+    err_code ec;
+    mTimer.cancel(ec);
+    mDeadline.cancel(ec);
+    mConnection.close();
+}
+
+Clock::duration Client::interArrival() {
+    double rate = mLoad.rate;
+    std::chrono::duration<double> secs(1.0 / rate);
+    if (mPoisson) {
+        std::exponential_distribution<double> dist(rate);
+        secs = std::chrono::duration<double>(dist(rnd.randomDevice()));
+    }
+    return std::chrono::duration_cast<Clock::duration>(secs);
+}
+
+void Client::pregenerate(size_t count) {
+    std::vector<Request> requests;
+    requests.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        requests.push_back(generate());
+    }
+    mStream = RequestStream(std::move(requests));
+}
+
+void Client::doTransaction(decltype(Clock::now()) start) {
+    auto req = mStream.empty() ? generate() : mStream.next();
+    if (mRecord) {
+        mRecorded.emplace_back(start, req);
+    }
+    send(req, start);
+}
+
+Request Client::generate() {
+    Request req;
+    std::memset(&req, 0, sizeof(req));
+    auto command = mWorkload.pick(rnd);
+    req.transaction = uint8_t(command);
+    req.w_id = mWarehouses.next(rnd);
+    auto lastName = [this, &req]() {
+        auto c_last = rnd.cLastName(rnd.NURand(255, 0, 999));
+        std::strncpy(req.c_last, c_last.c_str(), sizeof(req.c_last) - 1);
+    };
+    switch (command) {
+    case Command::STOCK_LEVEL:
+        req.d_id  = mCurrDistrict;
+        req.value = rnd.randomWithin<int32_t>(10, 20);
         mCurrDistrict = mCurrDistrict == 10 ? 1 : (mCurrDistrict + 1);
-    } else if (n <= 8) {
-        DeliveryIn arg;
-        arg.w_id         = mCurrWarehouse;
-        arg.o_carrier_id = rnd.random<int16_t>(1, 10);
-        execute<Command::DELIVERY>(arg);
-    } else if (n <= 12) {
-        OrderStatusIn arg;
-        arg.w_id             = mCurrWarehouse;
-        arg.d_id             = rnd.random<int16_t>(1, 10);
-        arg.selectByLastName = 6 <= rnd.random<int>(1, 10);
-        if (arg.selectByLastName) {
-            arg.c_last = rnd.cLastName(rnd.NURand(255, 0, 999));
+        break;
+    case Command::DELIVERY:
+        req.value = rnd.random<int16_t>(1, 10);
+        break;
+    case Command::ORDER_STATUS:
+        req.d_id             = rnd.random<int16_t>(1, 10);
+        req.selectByLastName = 6 <= rnd.random<int>(1, 10);
+        if (req.selectByLastName) {
+            lastName();
         } else {
-            arg.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
+            req.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
         }
-        execute<Command::ORDER_STATUS>(arg);
-    } else if (n <= 55) {
-        PaymentIn arg;
-        arg.w_id = mCurrWarehouse;
-        arg.d_id = rnd.random<int16_t>(1, 10);
+        break;
+    case Command::PAYMENT: {
+        req.d_id = rnd.random<int16_t>(1, 10);
         auto x   = rnd.random(1, 100);
-        if (x <= 85) {
-            arg.c_w_id = mCurrWarehouse;
-            arg.c_d_id = arg.d_id;
+        if (x > mWorkload.remotePayment) {
+            req.c_w_id = req.w_id;
+            req.c_d_id = req.d_id;
         } else {
-            arg.c_w_id = rnd.random<int16_t>(1, mNumWarehouses);
-            arg.c_d_id = rnd.random<int16_t>(1, 10);
+            req.c_w_id = rnd.random<int16_t>(1, mNumWarehouses);
+            req.c_d_id = rnd.random<int16_t>(1, 10);
         }
         auto y = rnd.random(1, 100);
-        arg.selectByLastName = y <= 60;
-        if (arg.selectByLastName) {
-            arg.c_last = rnd.cLastName(rnd.NURand(255, 0, 999));
+        req.selectByLastName = y <= 60;
+        if (req.selectByLastName) {
+            lastName();
         } else {
-            arg.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
+            req.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
         }
-        arg.h_amount = rnd.random<int32_t>(100, 500000);
-        execute<Command::PAYMENT>(arg);
-    } else {
-        NewOrderIn arg;
-        arg.w_id = mCurrWarehouse;
-        arg.d_id = rnd.random<int16_t>(1, 10);
-        arg.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
-        execute<Command::NEW_ORDER>(arg);
+        req.value = rnd.random<int32_t>(100, 500000);
+        break;
+    }
+    default:
+        req.d_id = rnd.random<int16_t>(1, 10);
+        req.c_id = rnd.NURand<int32_t>(1023, 1, 3000);
+        req.remote_stock_pct = mWorkload.remoteStock;
+        break;
     }
-    mCurrWarehouse = mCurrWarehouse == mWareHouseUpper ? mWareHouseLower
-                                                       : (mCurrWarehouse + 1);
+    return req;
 }
 
-void Client::populate(bool useCH) { populate(mWareHouseLower, mWareHouseUpper, useCH); }
-
-void Client::populate(int16_t lower, int16_t upper, bool useCH) {
-    mCmds.execute<Command::POPULATE_WAREHOUSE>(
-      [this, lower, upper, useCH](const err_code &ec,
-                           const std::tuple<bool, crossbow::string> &res) {
-          if (ec) {
-              LOG_ERROR(ec.message());
-              return;
-          }
-          LOG_ASSERT(std::get<0>(res), std::get<1>(res));
-          LOG_INFO(("Populated Warehouse " + crossbow::to_string(lower)));
-          if (lower == upper) {
-              mSocket.shutdown(Socket::shutdown_both);
-              mSocket.close();
-              return; // population done
-          }
-          populate(lower + 1, upper, useCH);
-      },
-      std::make_tuple(lower, useCH));
+void Client::send(const Request& req, decltype(Clock::now()) start) {
+    switch (req.command()) {
+    case Command::STOCK_LEVEL: {
+        StockLevelIn args;
+        args.w_id      = req.w_id;
+        args.d_id      = req.d_id;
+        args.threshold = req.value;
+        args.deadline_ms = mWorkload.deadline;
+        execute<Command::STOCK_LEVEL>(args, start);
+        break;
+    }
+    case Command::DELIVERY: {
+        DeliveryIn arg;
+        arg.w_id         = req.w_id;
+        arg.o_carrier_id = int16_t(req.value);
+        arg.deadline_ms  = mWorkload.deadline;
+        execute<Command::DELIVERY>(arg, start);
+        break;
+    }
+    case Command::ORDER_STATUS: {
+        OrderStatusIn arg;
+        arg.w_id             = req.w_id;
+        arg.d_id             = req.d_id;
+        arg.selectByLastName = req.selectByLastName;
+        arg.c_id             = req.c_id;
+        arg.c_last           = req.c_last;
+        arg.deadline_ms      = mWorkload.deadline;
+        execute<Command::ORDER_STATUS>(arg, start);
+        break;
+    }
+    case Command::PAYMENT: {
+        PaymentIn arg;
+        arg.w_id             = req.w_id;
+        arg.d_id             = req.d_id;
+        arg.c_w_id           = req.c_w_id;
+        arg.c_d_id           = req.c_d_id;
+        arg.selectByLastName = req.selectByLastName;
+        arg.c_id             = req.c_id;
+        arg.c_last           = req.c_last;
+        arg.h_amount         = req.value;
+        arg.deadline_ms      = mWorkload.deadline;
+        execute<Command::PAYMENT>(arg, start);
+        break;
+    }
+    default: {
+        NewOrderIn arg;
+        arg.w_id             = req.w_id;
+        arg.d_id             = req.d_id;
+        arg.c_id             = req.c_id;
+        arg.remote_stock_pct = req.remote_stock_pct;
+        arg.summary_only     = mWorkload.summaryOnly;
+        arg.deadline_ms      = mWorkload.deadline;
+        execute<Command::NEW_ORDER>(arg, start);
+        break;
+    }
+    }
 }
 
 } // namespace tpcc
@@ -22,16 +22,22 @@
  */
 #pragma once
 #include <boost/asio.hpp>
+#include <boost/asio/system_timer.hpp>
 #include <common/Protocol.hpp>
 #include <random>
+#include <atomic>
 #include <chrono>
 #include <deque>
+#include <utility>
+#include <vector>
 
 #include <common/Util.hpp>
 
-namespace tpcc {
+#include "RequestStream.hpp"
+#include "Statistics.hpp"
+#include "Workload.hpp"
 
-using Clock = std::chrono::system_clock;
+namespace tpcc {
 
 struct LogEntry {
     bool success;
@@ -41,45 +47,103 @@ struct LogEntry {
     decltype(start) end;
 };
 
+// Offered load shared by all clients, the saturation search changes it
+// while the benchmark runs
+struct LoadControl {
+    // open loop: transactions per second of every client, 0 runs closed loop
+    std::atomic<double> rate;
+    std::atomic<bool> stopped;
+
+    explicit LoadControl(double rate)
+        : rate(rate)
+        , stopped(false)
+    {}
+};
+
 class Client {
-    using Socket = boost::asio::ip::tcp::socket;
-    Socket mSocket;
+    TransportStream mConnection;
     client::CommandsImpl mCmds;
     int16_t mNumWarehouses;
-    int16_t mWareHouseLower;
-    int16_t mWareHouseUpper;
-    int16_t mCurrWarehouse;
+    const Workload& mWorkload;
+    WarehouseChooser mWarehouses;
     int16_t mCurrDistrict;
     Random_t rnd;
+    // if not empty, requests are taken from here instead of generated on the fly
+    RequestStream mStream;
+    // replay: send times of the requests in mStream relative to the start of the run
+    bool mReplay = false;
+    std::vector<Clock::duration> mSchedule;
+    size_t mScheduled = 0;
+    decltype(Clock::now()) mReplayStart;
+    bool mArrivalsDone = false;
+    // every sent request with its start time, only kept when recording
+    bool mRecord = false;
+    std::deque<std::pair<decltype(Clock::now()), Request>> mRecorded;
+    Statistics& mStats;
+    // the raw per-transaction log is only kept if requested
+    bool mRawLog;
     std::deque<LogEntry> mLog;
     decltype(Clock::now()) mEndTime;
+    LoadControl& mLoad;
+    bool mPoisson;
+    boost::asio::system_timer mTimer;
+    decltype(Clock::now()) mNextArrival;
+    // intended send times of arrived but not yet sent transactions
+    std::deque<decltype(Clock::now())> mPending;
+    bool mBusy = false;
+    // expires when the request in flight missed its deadline, mSequence
+    // tells a stale expiry from the current one
+    boost::asio::system_timer mDeadline;
+    uint64_t mSequence = 0;
+    bool mExpired = false;
 public:
-    Client(boost::asio::io_service& service, int16_t numWarehouses, int16_t wareHouseLower, int16_t wareHouseUpper, decltype(Clock::now()) endTime)
-        : mSocket(service)
-        , mCmds(mSocket)
+    Client(boost::asio::io_service& service, int16_t numWarehouses, int16_t wareHouseLower, int16_t wareHouseUpper,
+            const Workload& workload, LoadControl& load, bool poisson, Statistics& stats, bool rawLog,
+            Random_t::RandomDevice::result_type seed)
+        : mConnection(service)
+        , mCmds(mConnection)
         , mNumWarehouses(numWarehouses)
-        , mWareHouseLower(wareHouseLower)
-        , mWareHouseUpper(wareHouseUpper)
-        , mCurrWarehouse(mWareHouseLower)
+        , mWorkload(workload)
+        , mWarehouses(workload, numWarehouses, wareHouseLower, wareHouseUpper)
         , mCurrDistrict(1)
-        , mEndTime(endTime)
+        , rnd(seed)
+        , mStats(stats)
+        , mRawLog(rawLog)
+        , mLoad(load)
+        , mPoisson(poisson)
+        , mTimer(service)
+        , mDeadline(service)
     {}
-    Socket& socket() {
-        return mSocket;
-    }
-    const Socket& socket() const {
-        return mSocket;
+    TransportStream& connection() {
+        return mConnection;
     }
     client::CommandsImpl& commands() {
         return mCmds;
     }
-    void run();
-    void populate(bool useCH);
+    void run(decltype(Clock::now()) endTime);
+    // generates the next count requests of this client up front
+    void pregenerate(size_t count);
+    void setStream(RequestStream stream) { mStream = std::move(stream); }
+    const RequestStream& stream() const { return mStream; }
+    // sends the requests of stream at the given times instead of closed or open loop
+    void setReplay(RequestStream stream, std::vector<Clock::duration> schedule) {
+        mReplay = true;
+        mStream = std::move(stream);
+        mSchedule = std::move(schedule);
+    }
+    void setRecording(bool record) { mRecord = record; }
+    const std::deque<std::pair<decltype(Clock::now()), Request>>& recorded() const { return mRecorded; }
     const std::deque<LogEntry>& log() const { return mLog; }
 private:
-    void populate(int16_t lower, int16_t upper, bool useCH);
+    void arrive();
+    void next();
+    void stop();
+    Clock::duration interArrival();
+    void doTransaction(decltype(Clock::now()) start);
+    Request generate();
+    void send(const Request& request, decltype(Clock::now()) start);
     template<Command C>
-    void execute(const typename Signature<C>::arguments& arg);
+    void execute(const typename Signature<C>::arguments& arg, decltype(Clock::now()) start);
 };
 
 }
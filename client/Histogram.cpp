@@ -0,0 +1,92 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace tpcc {
+
+constexpr unsigned Histogram::NUM_BUCKETS;
+
+unsigned Histogram::indexOf(uint64_t value) {
+    if (value < (uint64_t(1) << SUB_BUCKET_BITS)) {
+        return unsigned(value);
+    }
+    unsigned msb = 63 - __builtin_clzll(value);
+    unsigned shift = msb - SUB_BUCKET_BITS + 1;
+    return shift * HALF_BUCKET_COUNT + unsigned(value >> shift);
+}
+
+uint64_t Histogram::highestEquivalent(unsigned index) {
+    if (index < (1u << SUB_BUCKET_BITS)) {
+        return index;
+    }
+    unsigned shift = (index / HALF_BUCKET_COUNT) - 1;
+    uint64_t sub = index - shift * HALF_BUCKET_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+    ++mCounts[indexOf(value)];
+    ++mCount;
+    mSum += value;
+    mMin = std::min(mMin, value);
+    mMax = std::max(mMax, value);
+}
+
+void Histogram::merge(const Histogram& other) {
+    if (other.mCount == 0) return;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+        mCounts[i] += other.mCounts[i];
+    }
+    mCount += other.mCount;
+    mSum += other.mSum;
+    mMin = std::min(mMin, other.mMin);
+    mMax = std::max(mMax, other.mMax);
+}
+
+void Histogram::reset() {
+    mCounts.fill(0);
+    mCount = 0;
+    mSum = 0;
+    mMin = std::numeric_limits<uint64_t>::max();
+    mMax = 0;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    if (mCount == 0) return 0;
+    auto rank = uint64_t(std::ceil(p / 100.0 * double(mCount)));
+    rank = std::max(rank, uint64_t(1));
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+        seen += mCounts[i];
+        if (seen >= rank) {
+            return std::min(highestEquivalent(i), mMax);
+        }
+    }
+    return mMax;
+}
+
+} // namespace tpcc
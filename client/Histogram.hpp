@@ -0,0 +1,63 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace tpcc {
+
+// Latency histogram with constant memory in the style of HdrHistogram.
+// Values below 2^SUB_BUCKET_BITS are counted exactly, above that every
+// power of two is split into 2^(SUB_BUCKET_BITS-1) buckets, which bounds
+// the relative error of a reported value to 2^-(SUB_BUCKET_BITS-1), 0.78%.
+class Histogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 8;
+    static constexpr unsigned HALF_BUCKET_COUNT = 1u << (SUB_BUCKET_BITS - 1);
+    static constexpr unsigned NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 2) * HALF_BUCKET_COUNT;
+private:
+    std::array<uint64_t, NUM_BUCKETS> mCounts;
+    uint64_t mCount;
+    uint64_t mSum;
+    uint64_t mMin;
+    uint64_t mMax;
+public:
+    Histogram() {
+        reset();
+    }
+    void record(uint64_t value);
+    void merge(const Histogram& other);
+    void reset();
+
+    uint64_t count() const { return mCount; }
+    uint64_t min() const { return mCount == 0 ? 0 : mMin; }
+    uint64_t max() const { return mMax; }
+    double mean() const { return mCount == 0 ? 0.0 : double(mSum) / double(mCount); }
+    // p is in percent, e.g. 99.9
+    uint64_t percentile(double p) const;
+private:
+    static unsigned indexOf(uint64_t value);
+    static uint64_t highestEquivalent(unsigned index);
+};
+
+} // namespace tpcc
@@ -0,0 +1,138 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "PopulateScheduler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <crossbow/logger.hpp>
+
+using err_code = boost::system::error_code;
+
+namespace tpcc {
+
+PopulateScheduler::PopulateScheduler(std::vector<Client*> clients, int16_t numWarehouses, bool useCH)
+    : mClients(std::move(clients))
+    , mNumWarehouses(numWarehouses)
+    , mUseCH(useCH)
+{}
+
+void PopulateScheduler::run() {
+    mStart = Clock::now();
+    auto& cmds = mClients[0]->commands();
+    cmds.execute<Command::CREATE_SCHEMA>([this](const err_code& ec, const std::tuple<bool, crossbow::string>& res) {
+        if (ec) {
+            LOG_ERROR(ec.message());
+            ++mFailed;
+            return;
+        }
+        if (!std::get<0>(res)) {
+            LOG_ERROR(std::get<1>(res));
+            ++mFailed;
+            return;
+        }
+        LOG_INFO("Created schema.");
+        populateDimTables();
+        // the first connection joins the warehouse queue once the dim tables are done
+        for (size_t i = 1; i < mClients.size(); ++i) {
+            populateNext(*mClients[i]);
+        }
+    }, std::make_tuple(mNumWarehouses, mUseCH));
+}
+
+void PopulateScheduler::populateDimTables() {
+    auto start = Clock::now();
+    auto& client = *mClients[0];
+    client.commands().execute<Command::POPULATE_DIM_TABLES>(
+            [this, &client, start](const err_code& ec, const std::tuple<bool, crossbow::string>& res) {
+        if (ec) {
+            LOG_ERROR(ec.message());
+            ++mFailed;
+            return;
+        }
+        if (!std::get<0>(res)) {
+            LOG_ERROR(std::get<1>(res));
+            ++mFailed;
+        } else {
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+            LOG_INFO("Populated dim tables in %1%ms", duration.count());
+        }
+        populateNext(client);
+    }, mUseCH);
+}
+
+void PopulateScheduler::populateNext(Client& client) {
+    if (mNextWarehouse > mNumWarehouses) {
+        close(client);
+        return;
+    }
+    auto w_id = mNextWarehouse++;
+    auto start = Clock::now();
+    client.commands().execute<Command::POPULATE_WAREHOUSE>(
+            [this, &client, w_id, start](const err_code& ec, const std::tuple<bool, crossbow::string>& res) {
+        if (ec) {
+            LOG_ERROR("Populating warehouse %1% failed: %2%", w_id, ec.message());
+            ++mFailed;
+            if (++mDone == mNumWarehouses) {
+                finished();
+            }
+            close(client);
+            return;
+        }
+        auto now = Clock::now();
+        ++mDone;
+        if (!std::get<0>(res)) {
+            LOG_ERROR("Populating warehouse %1% failed: %2%", w_id, std::get<1>(res));
+            ++mFailed;
+        } else {
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
+            mMinTime = std::min(mMinTime, duration);
+            mMaxTime = std::max(mMaxTime, duration);
+            mSumTime += duration;
+            ++mPopulated;
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - mStart).count();
+            auto remaining = elapsed * (mNumWarehouses - mDone) / mDone;
+            LOG_INFO("Populated warehouse %1% in %2%ms (%3%/%4% done, %5%s elapsed, ~%6%s remaining)",
+                    w_id, duration.count(), mDone, mNumWarehouses, elapsed, remaining);
+        }
+        if (mDone == mNumWarehouses) {
+            finished();
+        }
+        populateNext(client);
+    }, std::make_tuple(w_id, mUseCH));
+}
+
+void PopulateScheduler::close(Client& client) {
+    client.connection().close();
+}
+
+void PopulateScheduler::finished() {
+    auto total = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - mStart);
+    LOG_INFO("Populated %1% warehouses over %2% connections in %3%ms, per warehouse min %4%ms avg %5%ms max %6%ms",
+            mPopulated, mClients.size(), total.count(),
+            mPopulated > 0 ? mMinTime.count() : 0,
+            mPopulated > 0 ? mSumTime.count() / mPopulated : 0,
+            mMaxTime.count());
+}
+
+} // namespace tpcc
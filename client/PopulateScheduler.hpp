@@ -0,0 +1,60 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "Client.hpp"
+
+namespace tpcc {
+
+// Creates the schema and loads the database over many connections: the
+// dim tables are populated on the first connection while all connections
+// take the next unpopulated warehouse from a shared queue, so the initial
+// load scales with the number of connections and servers.
+class PopulateScheduler {
+    std::vector<Client*> mClients;
+    int16_t mNumWarehouses;
+    bool mUseCH;
+    int16_t mNextWarehouse = 1;
+    int16_t mDone = 0;
+    int16_t mPopulated = 0;
+    unsigned mFailed = 0;
+    decltype(Clock::now()) mStart;
+    std::chrono::milliseconds mMinTime = std::chrono::milliseconds::max();
+    std::chrono::milliseconds mMaxTime = std::chrono::milliseconds::zero();
+    std::chrono::milliseconds mSumTime = std::chrono::milliseconds::zero();
+public:
+    PopulateScheduler(std::vector<Client*> clients, int16_t numWarehouses, bool useCH);
+    void run();
+    // number of warehouses or dim table loads that failed
+    unsigned failed() const { return mFailed; }
+private:
+    void populateDimTables();
+    void populateNext(Client& client);
+    void close(Client& client);
+    void finished();
+};
+
+} // namespace tpcc
@@ -0,0 +1,130 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Reporter.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace tpcc {
+
+Reporter::Reporter(boost::asio::io_service& service,
+        std::vector<Statistics*> stats,
+        std::chrono::seconds interval,
+        const std::string& file,
+        decltype(Clock::now()) startTime,
+        decltype(Clock::now()) endTime)
+    : mTimer(service)
+    , mStats(std::move(stats))
+    , mInterval(interval)
+    , mOut(file.c_str(), std::ios_base::app)
+    , mStartTime(startTime)
+    , mEndTime(endTime)
+    , mLast(startTime)
+{
+    if (!mOut) {
+        throw std::runtime_error("Could not open " + file);
+    }
+    // runs append to the same file, only the first one writes the header
+    mOut.seekp(0, std::ios_base::end);
+    if (mOut.tellp() == 0) {
+        mOut << "time,transaction,committed,aborted,timeouts,rejected,tps,abort_rate,tpmC,p50,p95,p99,p99.9\n";
+    }
+}
+
+void Reporter::run() {
+    schedule();
+}
+
+void Reporter::schedule() {
+    if (mLast >= mEndTime) return;
+    auto next = std::min(mLast + mInterval, mEndTime);
+    mTimer.expires_at(next);
+    mTimer.async_wait([this, next](const boost::system::error_code& ec) {
+        if (ec) return;
+        report();
+        mLast = next;
+        schedule();
+    });
+}
+
+void Reporter::report() {
+    auto now = Clock::now();
+    Statistics::Snapshot interval;
+    for (auto stats : mStats) {
+        merge(interval, stats->takeInterval());
+    }
+    auto secs = std::chrono::duration<double>(now - mLast).count();
+    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - mStartTime).count();
+    auto tpmC = secs > 0 ? double(interval[0].committed) * 60.0 / secs : 0.0;
+    TransactionStats all;
+    for (const auto& s : interval) {
+        all.merge(s);
+    }
+    auto ms = [](uint64_t us) { return double(us) / 1000.0; };
+    auto writeRow = [&](const char* name, const TransactionStats& s) {
+        auto count = s.committed + s.aborted + s.timedOut + s.rejected;
+        mOut << elapsed << ',' << name << ','
+            << s.committed << ','
+            << s.aborted << ','
+            << s.timedOut << ','
+            << s.rejected << ','
+            << (secs > 0 ? double(s.committed) / secs : 0.0) << ','
+            << (count > 0 ? double(s.aborted) / double(count) : 0.0) << ','
+            << tpmC << ','
+            << ms(s.latency.percentile(50)) << ','
+            << ms(s.latency.percentile(95)) << ','
+            << ms(s.latency.percentile(99)) << ','
+            << ms(s.latency.percentile(99.9)) << '\n';
+    };
+    for (size_t i = 0; i < interval.size(); ++i) {
+        writeRow(Statistics::nameOf(i), interval[i]);
+    }
+    writeRow("All", all);
+    mOut.flush();
+
+    auto count = all.committed + all.aborted + all.timedOut + all.rejected;
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1)
+        << '[' << std::setw(5) << elapsed << "s] tpmC " << tpmC << " |";
+    for (size_t i = 0; i < interval.size(); ++i) {
+        line << ' ' << Statistics::nameOf(i) << ' ' << (secs > 0 ? double(interval[i].committed) / secs : 0.0) << "/s";
+    }
+    line << " | aborts " << (count > 0 ? 100.0 * double(all.aborted) / double(count) : 0.0) << '%';
+    if (all.timedOut > 0) {
+        line << " timeouts " << 100.0 * double(all.timedOut) / double(count) << '%';
+    }
+    if (all.rejected > 0) {
+        line << " rejected " << 100.0 * double(all.rejected) / double(count) << '%';
+    }
+    line << " | p50 " << ms(all.latency.percentile(50))
+        << " p95 " << ms(all.latency.percentile(95))
+        << " p99 " << ms(all.latency.percentile(99))
+        << " p99.9 " << ms(all.latency.percentile(99.9)) << " ms";
+    std::cout << line.str() << std::endl;
+}
+
+} // namespace tpcc
@@ -0,0 +1,58 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/system_timer.hpp>
+
+#include "Statistics.hpp"
+
+namespace tpcc {
+
+// Periodically prints the throughput, abort rate and latency percentiles of
+// the last interval over all client threads and appends them to a CSV file
+class Reporter {
+    boost::asio::system_timer mTimer;
+    std::vector<Statistics*> mStats;
+    std::chrono::seconds mInterval;
+    std::ofstream mOut;
+    decltype(Clock::now()) mStartTime;
+    decltype(Clock::now()) mEndTime;
+    decltype(Clock::now()) mLast;
+public:
+    Reporter(boost::asio::io_service& service,
+            std::vector<Statistics*> stats,
+            std::chrono::seconds interval,
+            const std::string& file,
+            decltype(Clock::now()) startTime,
+            decltype(Clock::now()) endTime);
+    void run();
+private:
+    void schedule();
+    void report();
+};
+
+} // namespace tpcc
@@ -0,0 +1,168 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "RequestStream.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace tpcc {
+
+static_assert(std::is_trivially_copyable<Request>::value, "Requests are written to files as is");
+static_assert(std::is_trivially_copyable<RecordedRequest>::value, "Requests are written to files as is");
+
+namespace {
+
+constexpr char MAGIC[8] = {'T', 'P', 'C', 'C', 'R', 'E', 'Q', '1'};
+constexpr char RECORDING_MAGIC[8] = {'T', 'P', 'C', 'C', 'R', 'E', 'C', '1'};
+
+// bytes between the read position and the end of the file
+uint64_t remaining(std::ifstream& in) {
+    auto pos = in.tellg();
+    in.seekg(0, std::ios_base::end);
+    auto end = in.tellg();
+    in.seekg(pos);
+    return uint64_t(end - pos);
+}
+
+// the counts come from the file, check them before allocating anything
+void checkCount(std::ifstream& in, const std::string& file, uint64_t count, size_t elementSize) {
+    if (count > remaining(in) / elementSize) {
+        throw std::runtime_error(file + " is truncated");
+    }
+}
+
+// loaded requests are sent as they are, so the command has to be a
+// transaction and c_last a C string. The flag may hold any byte in the
+// file, it is read as such and normalized.
+void checkRequest(Request& req, const std::string& file) {
+    if (req.transaction < uint8_t(Command::NEW_ORDER) || req.transaction > uint8_t(Command::STOCK_LEVEL)
+            || req.c_last[sizeof(req.c_last) - 1] != '\0') {
+        throw std::runtime_error(file + " contains an invalid request");
+    }
+    uint8_t selectByLastName;
+    std::memcpy(&selectByLastName, &req.selectByLastName, sizeof(selectByLastName));
+    req.selectByLastName = selectByLastName != 0;
+}
+
+} // anonymous namespace
+
+RequestStream::RequestStream(std::vector<Request> requests)
+    : mRequests(std::move(requests))
+{}
+
+void saveStreams(const std::string& file, const std::vector<const RequestStream*>& streams) {
+    std::ofstream out(file.c_str(), std::ios_base::binary | std::ios_base::trunc);
+    if (!out) {
+        throw std::runtime_error("Could not open " + file);
+    }
+    uint64_t numStreams = streams.size();
+    out.write(MAGIC, sizeof(MAGIC));
+    out.write(reinterpret_cast<const char*>(&numStreams), sizeof(numStreams));
+    for (auto stream : streams) {
+        const auto& requests = stream->requests();
+        uint64_t size = requests.size();
+        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        out.write(reinterpret_cast<const char*>(requests.data()), std::streamsize(size * sizeof(Request)));
+    }
+    if (!out) {
+        throw std::runtime_error("Could not write " + file);
+    }
+}
+
+std::vector<RequestStream> loadStreams(const std::string& file) {
+    std::ifstream in(file.c_str(), std::ios_base::binary);
+    if (!in) {
+        throw std::runtime_error("Could not open " + file);
+    }
+    char magic[sizeof(MAGIC)];
+    uint64_t numStreams = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&numStreams), sizeof(numStreams));
+    if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(file + " is not a request stream file");
+    }
+    checkCount(in, file, numStreams, sizeof(uint64_t));
+    std::vector<RequestStream> res;
+    res.reserve(numStreams);
+    for (uint64_t i = 0; i < numStreams; ++i) {
+        uint64_t size = 0;
+        in.read(reinterpret_cast<char*>(&size), sizeof(size));
+        if (!in) {
+            throw std::runtime_error(file + " is truncated");
+        }
+        checkCount(in, file, size, sizeof(Request));
+        std::vector<Request> requests(size);
+        in.read(reinterpret_cast<char*>(requests.data()), std::streamsize(size * sizeof(Request)));
+        if (!in) {
+            throw std::runtime_error(file + " is truncated");
+        }
+        for (auto& req : requests) {
+            checkRequest(req, file);
+        }
+        res.emplace_back(std::move(requests));
+    }
+    return res;
+}
+
+void saveRecording(const std::string& file, const std::vector<RecordedRequest>& requests) {
+    std::ofstream out(file.c_str(), std::ios_base::binary | std::ios_base::trunc);
+    if (!out) {
+        throw std::runtime_error("Could not open " + file);
+    }
+    uint64_t size = requests.size();
+    out.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.write(reinterpret_cast<const char*>(requests.data()), std::streamsize(size * sizeof(RecordedRequest)));
+    if (!out) {
+        throw std::runtime_error("Could not write " + file);
+    }
+}
+
+std::vector<RecordedRequest> loadRecording(const std::string& file) {
+    std::ifstream in(file.c_str(), std::ios_base::binary);
+    if (!in) {
+        throw std::runtime_error("Could not open " + file);
+    }
+    char magic[sizeof(RECORDING_MAGIC)];
+    uint64_t size = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!in || std::memcmp(magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0) {
+        throw std::runtime_error(file + " is not a recording");
+    }
+    checkCount(in, file, size, sizeof(RecordedRequest));
+    std::vector<RecordedRequest> res(size);
+    in.read(reinterpret_cast<char*>(res.data()), std::streamsize(size * sizeof(RecordedRequest)));
+    if (!in) {
+        throw std::runtime_error(file + " is truncated");
+    }
+    for (auto& rec : res) {
+        checkRequest(rec.request, file);
+    }
+    return res;
+}
+
+} // namespace tpcc
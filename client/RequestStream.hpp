@@ -0,0 +1,83 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <common/Protocol.hpp>
+
+namespace tpcc {
+
+// All input of one transaction in a fixed size record, so request streams
+// can be generated up front and written to and read from files as is
+struct Request {
+    uint8_t transaction;     // a Command
+    bool selectByLastName;
+    int16_t w_id;
+    int16_t d_id;
+    int16_t c_w_id;
+    int16_t c_d_id;
+    int16_t remote_stock_pct;
+    int32_t c_id;
+    int32_t value;           // h_amount, o_carrier_id or threshold
+    char c_last[16];         // NUL terminated, last names are at most 15 characters
+
+    Command command() const { return Command(transaction); }
+};
+
+// The pre-generated requests of one client, next() wraps around when the
+// stream is exhausted
+class RequestStream {
+    std::vector<Request> mRequests;
+    size_t mPos = 0;
+public:
+    RequestStream() = default;
+    explicit RequestStream(std::vector<Request> requests);
+
+    bool empty() const { return mRequests.empty(); }
+    const std::vector<Request>& requests() const { return mRequests; }
+
+    const Request& next() {
+        const auto& res = mRequests[mPos];
+        if (++mPos == mRequests.size()) mPos = 0;
+        return res;
+    }
+};
+
+// A request as it was sent during a recorded run
+struct RecordedRequest {
+    int64_t offset;       // start time in microseconds since the start of the run
+    uint32_t connection;  // index of the client that sent it
+    uint32_t reserved;
+    Request request;
+};
+
+// All of these throw std::runtime_error if the file can not be written or read
+void saveStreams(const std::string& file, const std::vector<const RequestStream*>& streams);
+std::vector<RequestStream> loadStreams(const std::string& file);
+void saveRecording(const std::string& file, const std::vector<RecordedRequest>& requests);
+std::vector<RecordedRequest> loadRecording(const std::string& file);
+
+} // namespace tpcc
@@ -0,0 +1,141 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "SaturationSearch.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <crossbow/logger.hpp>
+
+namespace tpcc {
+
+SaturationSearch::SaturationSearch(boost::asio::io_service& service,
+        std::vector<Statistics*> stats,
+        LoadControl& load,
+        size_t numClients,
+        double startRate,
+        double rateStep,
+        std::chrono::seconds stepTime,
+        std::chrono::microseconds sla,
+        decltype(Clock::now()) endTime,
+        const std::string& file)
+    : mTimer(service)
+    , mStats(std::move(stats))
+    , mLoad(load)
+    , mNumClients(numClients)
+    , mStartRate(startRate)
+    , mRateStep(rateStep)
+    , mStepTime(stepTime)
+    , mSla(sla)
+    , mEndTime(endTime)
+    , mOut(file.c_str())
+{
+    if (!mOut) {
+        throw std::runtime_error("Could not open " + file);
+    }
+    mOut << "step,offered_tps,tps,abort_rate,tpmC,p50,p95,p99,p99.9,sla_met\n";
+}
+
+void SaturationSearch::run() {
+    startStep();
+}
+
+void SaturationSearch::startStep() {
+    auto now = Clock::now();
+    if (now + mStepTime > mEndTime) {
+        LOG_WARN("Benchmark time is over before the latency SLA was violated");
+        finish();
+        return;
+    }
+    mRate = mStartRate + mStep * mRateStep;
+    mLoad.rate = mRate / double(mNumClients);
+    // whatever completed at the previous rate does not count for this step
+    for (auto stats : mStats) {
+        stats->takeInterval();
+    }
+    mStepBegin = now;
+    mTimer.expires_at(now + mStepTime);
+    mTimer.async_wait([this](const boost::system::error_code& ec) {
+        if (ec) return;
+        finishStep();
+    });
+}
+
+void SaturationSearch::finishStep() {
+    Statistics::Snapshot interval;
+    for (auto stats : mStats) {
+        merge(interval, stats->takeInterval());
+    }
+    TransactionStats all;
+    for (const auto& s : interval) {
+        all.merge(s);
+    }
+    auto secs = std::chrono::duration<double>(Clock::now() - mStepBegin).count();
+    auto tps = double(all.committed) / secs;
+    auto tpmC = double(interval[0].committed) * 60.0 / secs;
+    auto count = all.committed + all.aborted + all.timedOut + all.rejected;
+    auto abortRate = count > 0 ? double(all.aborted) / double(count) : 0.0;
+    auto p99 = all.latency.percentile(99);
+    // timed out and rejected transactions are not in the histogram, they
+    // count as slower than the SLA, so more than 1% of them violates it
+    auto failed = all.timedOut + all.rejected;
+    bool slaMet = count > 0 && p99 <= uint64_t(mSla.count()) && failed * 100 <= count;
+    auto ms = [](uint64_t us) { return double(us) / 1000.0; };
+    mOut << mStep << ',' << mRate << ',' << tps << ',' << abortRate << ',' << tpmC << ','
+        << ms(all.latency.percentile(50)) << ','
+        << ms(all.latency.percentile(95)) << ','
+        << ms(p99) << ','
+        << ms(all.latency.percentile(99.9)) << ','
+        << (slaMet ? "true" : "false") << '\n';
+    mOut.flush();
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1)
+        << "[step " << mStep << "] offered " << mRate << "/s achieved " << tps << "/s"
+        << " | tpmC " << tpmC
+        << " | aborts " << 100.0 * abortRate << '%'
+        << " | p99 " << ms(p99) << " ms" << (slaMet ? "" : " > SLA");
+    std::cout << line.str() << std::endl;
+
+    if (!slaMet) {
+        finish();
+        return;
+    }
+    if (tpmC > mMaxTpmC) {
+        mMaxTpmC = tpmC;
+        mMaxRate = mRate;
+    }
+    ++mStep;
+    startStep();
+}
+
+void SaturationSearch::finish() {
+    mLoad.stopped = true;
+    std::cout << "Max sustainable tpmC: " << std::fixed << std::setprecision(1) << mMaxTpmC
+        << " (offered " << mMaxRate << " transactions/s)" << std::endl;
+}
+
+} // namespace tpcc
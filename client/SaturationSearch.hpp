@@ -0,0 +1,77 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/system_timer.hpp>
+
+#include "Client.hpp"
+#include "Statistics.hpp"
+
+namespace tpcc {
+
+// Ramps up the offered load of the open loop clients in fixed steps and
+// measures throughput and p99 latency of every step. The search stops at
+// the first step that violates the latency SLA and reports the highest
+// tpmC reached before.
+class SaturationSearch {
+    boost::asio::system_timer mTimer;
+    std::vector<Statistics*> mStats;
+    LoadControl& mLoad;
+    size_t mNumClients;
+    double mStartRate;
+    double mRateStep;
+    std::chrono::seconds mStepTime;
+    std::chrono::microseconds mSla;
+    decltype(Clock::now()) mEndTime;
+    std::ofstream mOut;
+    unsigned mStep = 0;
+    double mRate = 0.0;
+    double mMaxTpmC = 0.0;
+    double mMaxRate = 0.0;
+    decltype(Clock::now()) mStepBegin;
+public:
+    SaturationSearch(boost::asio::io_service& service,
+            std::vector<Statistics*> stats,
+            LoadControl& load,
+            size_t numClients,
+            double startRate,
+            double rateStep,
+            std::chrono::seconds stepTime,
+            std::chrono::microseconds sla,
+            decltype(Clock::now()) endTime,
+            const std::string& file);
+    void run();
+    // highest tpmC of a step that met the SLA
+    double maxTpmC() const { return mMaxTpmC; }
+private:
+    void startStep();
+    void finishStep();
+    void finish();
+};
+
+} // namespace tpcc
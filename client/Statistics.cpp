@@ -0,0 +1,153 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Statistics.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <ostream>
+
+namespace tpcc {
+
+constexpr size_t Statistics::NUM_TRANSACTIONS;
+
+void TransactionStats::merge(const TransactionStats& other) {
+    latency.merge(other.latency);
+    failedLatency.merge(other.failedLatency);
+    committed += other.committed;
+    aborted += other.aborted;
+    timedOut += other.timedOut;
+    rejected += other.rejected;
+}
+
+void TransactionStats::reset() {
+    latency.reset();
+    failedLatency.reset();
+    committed = 0;
+    aborted = 0;
+    timedOut = 0;
+    rejected = 0;
+}
+
+size_t Statistics::indexOf(Command transaction) {
+    switch (transaction) {
+    case Command::NEW_ORDER:
+        return 0;
+    case Command::PAYMENT:
+        return 1;
+    case Command::ORDER_STATUS:
+        return 2;
+    case Command::DELIVERY:
+        return 3;
+    case Command::STOCK_LEVEL:
+        return 4;
+    default:
+        assert(false);
+        return 0;
+    }
+}
+
+const char* Statistics::nameOf(size_t index) {
+    static const char* names[NUM_TRANSACTIONS] = {"New Order", "Payment", "Order Status", "Delivery", "Stock Level"};
+    return names[index];
+}
+
+void Statistics::record(Command transaction, Outcome outcome, decltype(Clock::now()) start, decltype(Clock::now()) end) {
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    auto value = uint64_t(std::max(latency, decltype(latency)(0)));
+    auto idx = indexOf(transaction);
+    auto add = [outcome, value](TransactionStats& stats) {
+        // rejections return almost immediately and timeouts after the
+        // deadline, mixing them in would skew the percentiles either way
+        switch (outcome) {
+        case Outcome::COMMITTED:
+            stats.latency.record(value);
+            ++stats.committed;
+            break;
+        case Outcome::ABORTED:
+            stats.latency.record(value);
+            ++stats.aborted;
+            break;
+        case Outcome::TIMED_OUT:
+            stats.failedLatency.record(value);
+            ++stats.timedOut;
+            break;
+        case Outcome::REJECTED:
+            stats.failedLatency.record(value);
+            ++stats.rejected;
+            break;
+        }
+    };
+    std::lock_guard<std::mutex> _(mMutex);
+    add(mInterval[idx]);
+    if (end >= mMeasureBegin && end < mMeasureEnd) {
+        add(mTotal[idx]);
+    }
+}
+
+Statistics::Snapshot Statistics::takeInterval() {
+    std::lock_guard<std::mutex> _(mMutex);
+    auto res = mInterval;
+    for (auto& s : mInterval) {
+        s.reset();
+    }
+    return res;
+}
+
+Statistics::Snapshot Statistics::total() const {
+    std::lock_guard<std::mutex> _(mMutex);
+    return mTotal;
+}
+
+void merge(Statistics::Snapshot& lhs, const Statistics::Snapshot& rhs) {
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        lhs[i].merge(rhs[i]);
+    }
+}
+
+void writeSummary(std::ostream& out, const Statistics::Snapshot& stats, std::chrono::milliseconds duration) {
+    auto secs = double(duration.count()) / 1000.0;
+    auto ms = [](uint64_t us) { return double(us) / 1000.0; };
+    out << "transaction,committed,aborted,timeouts,rejected,tps,mean,p50,p95,p99,p99.9,max,failed_p99\n";
+    out << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const auto& s = stats[i];
+        out << Statistics::nameOf(i) << ','
+            << s.committed << ','
+            << s.aborted << ','
+            << s.timedOut << ','
+            << s.rejected << ','
+            << (secs > 0 ? double(s.committed) / secs : 0.0) << ','
+            << ms(uint64_t(s.latency.mean())) << ','
+            << ms(s.latency.percentile(50)) << ','
+            << ms(s.latency.percentile(95)) << ','
+            << ms(s.latency.percentile(99)) << ','
+            << ms(s.latency.percentile(99.9)) << ','
+            << ms(s.latency.max()) << ','
+            << ms(s.failedLatency.percentile(99)) << '\n';
+    }
+    out << "tpmC," << (secs > 0 ? double(stats[0].committed) * 60.0 / secs : 0.0) << '\n';
+    out.unsetf(std::ios_base::floatfield);
+}
+
+} // namespace tpcc
@@ -0,0 +1,95 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+
+#include <common/Protocol.hpp>
+
+#include "Histogram.hpp"
+
+namespace tpcc {
+
+using Clock = std::chrono::system_clock;
+
+enum class Outcome {
+    COMMITTED,
+    ABORTED,
+    TIMED_OUT, // rolled back by the server because it missed its deadline
+    REJECTED   // not run because the server was overloaded
+};
+
+struct TransactionStats {
+    Histogram latency; // in microseconds, committed and aborted transactions only
+    Histogram failedLatency; // time until a transaction timed out or was rejected
+    uint64_t committed = 0;
+    uint64_t aborted = 0;
+    uint64_t timedOut = 0;
+    uint64_t rejected = 0;
+
+    void merge(const TransactionStats& other);
+    void reset();
+};
+
+// Counters and latency histograms per transaction type. Everything is
+// collected for the current interval, takeInterval() hands it out and
+// resets it, so memory stays constant over the run. The totals only
+// contain transactions that completed inside the measurement window,
+// which excludes warm-up and cool-down.
+// Every client thread owns one instance, the mutex is only contended
+// when the reporter takes an interval.
+class Statistics {
+public:
+    static constexpr size_t NUM_TRANSACTIONS = 5;
+    using Snapshot = std::array<TransactionStats, NUM_TRANSACTIONS>;
+private:
+    mutable std::mutex mMutex;
+    decltype(Clock::now()) mMeasureBegin = decltype(Clock::now())::min();
+    decltype(Clock::now()) mMeasureEnd = decltype(Clock::now())::max();
+    Snapshot mInterval;
+    Snapshot mTotal;
+public:
+    static size_t indexOf(Command transaction);
+    static const char* nameOf(size_t index);
+
+    // must be set before the clients start
+    void setWindow(decltype(Clock::now()) measureBegin, decltype(Clock::now()) measureEnd) {
+        mMeasureBegin = measureBegin;
+        mMeasureEnd = measureEnd;
+    }
+    void record(Command transaction, Outcome outcome, decltype(Clock::now()) start, decltype(Clock::now()) end);
+    Snapshot takeInterval();
+    Snapshot total() const;
+};
+
+void merge(Statistics::Snapshot& lhs, const Statistics::Snapshot& rhs);
+
+// Writes one line per transaction type with throughput and latency
+// percentiles in milliseconds, followed by the tpmC. The percentiles are
+// over executed transactions, failed_p99 over timed out and rejected ones.
+void writeSummary(std::ostream& out, const Statistics::Snapshot& stats, std::chrono::milliseconds duration);
+
+} // namespace tpcc
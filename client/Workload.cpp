@@ -0,0 +1,149 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Workload.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace tpcc {
+
+void Workload::parseMix(const std::string& str) {
+    auto parts = split(str, ',');
+    if (parts.size() != mix.size()) {
+        throw std::invalid_argument("The mix needs " + std::to_string(mix.size()) + " weights");
+    }
+    unsigned sum = 0;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        size_t pos = 0;
+        auto weight = std::stoi(parts[i], &pos);
+        if (pos != parts[i].size() || weight < 0) {
+            throw std::invalid_argument("Invalid weight " + parts[i]);
+        }
+        mix[i] = unsigned(weight);
+        sum += mix[i];
+    }
+    if (sum == 0) {
+        throw std::invalid_argument("All weights of the mix are zero");
+    }
+}
+
+void Workload::parseDistribution(const std::string& str) {
+    auto parts = split(str, ':');
+    if (parts.empty()) {
+        throw std::invalid_argument("Empty warehouse distribution");
+    }
+    const auto& name = parts[0];
+    if (name == "round-robin" && parts.size() == 1) {
+        distribution = Distribution::ROUND_ROBIN;
+    } else if (name == "uniform" && parts.size() == 1) {
+        distribution = Distribution::UNIFORM;
+    } else if (name == "zipf" && parts.size() <= 2) {
+        distribution = Distribution::ZIPF;
+        if (parts.size() == 2) zipfTheta = std::stod(parts[1]);
+        if (zipfTheta <= 0.0 || zipfTheta >= 1.0) {
+            throw std::invalid_argument("The zipf theta has to be in (0, 1)");
+        }
+    } else if (name == "hotset" && parts.size() <= 3) {
+        distribution = Distribution::HOT_SET;
+        if (parts.size() >= 2) hotSetSize = std::stod(parts[1]);
+        if (parts.size() == 3) hotSetProbability = std::stod(parts[2]);
+        if (hotSetSize <= 0.0 || hotSetSize > 1.0 || hotSetProbability < 0.0 || hotSetProbability > 1.0) {
+            throw std::invalid_argument("Hot set size has to be in (0, 1] and its probability in [0, 1]");
+        }
+    } else {
+        throw std::invalid_argument("Unknown warehouse distribution " + str);
+    }
+}
+
+Command Workload::pick(Random_t& rnd) const {
+    static const Command commands[] = {Command::NEW_ORDER, Command::PAYMENT, Command::ORDER_STATUS,
+        Command::DELIVERY, Command::STOCK_LEVEL};
+    unsigned sum = 0;
+    for (auto w : mix) {
+        sum += w;
+    }
+    auto n = rnd.random<unsigned>(1, sum);
+    for (size_t i = 0; i < mix.size(); ++i) {
+        if (n <= mix[i]) return commands[i];
+        n -= mix[i];
+    }
+    return commands[0];
+}
+
+WarehouseChooser::WarehouseChooser(const Workload& workload, int16_t numWarehouses, int16_t lower, int16_t upper)
+    : mWorkload(workload)
+    , mNumWarehouses(numWarehouses)
+    , mLower(lower)
+    , mUpper(upper)
+    , mCurr(lower)
+{
+    switch (mWorkload.distribution) {
+    case Workload::Distribution::ZIPF: {
+        auto theta = mWorkload.zipfTheta;
+        for (int i = 1; i <= mNumWarehouses; ++i) {
+            mZetaN += 1.0 / std::pow(double(i), theta);
+        }
+        auto zeta2 = 1.0 + std::pow(0.5, theta);
+        mAlpha = 1.0 / (1.0 - theta);
+        mEta = (1.0 - std::pow(2.0 / mNumWarehouses, 1.0 - theta)) / (1.0 - zeta2 / mZetaN);
+        break;
+    }
+    case Workload::Distribution::HOT_SET:
+        mHotWarehouses = int16_t(std::max(1L, std::lround(mNumWarehouses * mWorkload.hotSetSize)));
+        break;
+    default:
+        break;
+    }
+}
+
+int16_t WarehouseChooser::next(Random_t& rnd) {
+    switch (mWorkload.distribution) {
+    case Workload::Distribution::ROUND_ROBIN: {
+        auto res = mCurr;
+        mCurr = mCurr == mUpper ? mLower : (mCurr + 1);
+        return res;
+    }
+    case Workload::Distribution::UNIFORM:
+        return rnd.random<int16_t>(1, mNumWarehouses);
+    case Workload::Distribution::ZIPF: {
+        if (mNumWarehouses == 1) return 1;
+        auto u = std::uniform_real_distribution<double>(0.0, 1.0)(rnd.randomDevice());
+        auto uz = u * mZetaN;
+        if (uz < 1.0) return 1;
+        if (uz < 1.0 + std::pow(0.5, mWorkload.zipfTheta)) return 2;
+        auto res = 1 + int(mNumWarehouses * std::pow(mEta * u - mEta + 1.0, mAlpha));
+        return int16_t(std::min(res, int(mNumWarehouses)));
+    }
+    case Workload::Distribution::HOT_SET: {
+        auto hot = std::uniform_real_distribution<double>(0.0, 1.0)(rnd.randomDevice()) < mWorkload.hotSetProbability;
+        if (hot || mHotWarehouses == mNumWarehouses) {
+            return rnd.random<int16_t>(1, mHotWarehouses);
+        }
+        return rnd.random<int16_t>(mHotWarehouses + 1, mNumWarehouses);
+    }
+    }
+    return mLower;
+}
+
+} // namespace tpcc
@@ -0,0 +1,85 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <array>
+#include <string>
+
+#include <common/Protocol.hpp>
+#include <common/Util.hpp>
+
+#include "Statistics.hpp"
+
+namespace tpcc {
+
+// Describes what the clients send: the transaction mix, how the warehouse
+// of a transaction is chosen and how often Payment and NewOrder go to a
+// remote warehouse. The defaults follow the TPC-C specification.
+struct Workload {
+    enum class Distribution {
+        ROUND_ROBIN, // every client cycles through its own warehouses
+        UNIFORM,     // uniform over all warehouses
+        ZIPF,        // zipfian over all warehouses, warehouse 1 is the hottest
+        HOT_SET      // a fraction of the warehouses gets most of the accesses
+    };
+
+    // weights in the order of Statistics: NewOrder, Payment, OrderStatus, Delivery, StockLevel
+    std::array<unsigned, Statistics::NUM_TRANSACTIONS> mix{{45, 43, 4, 4, 4}};
+    Distribution distribution = Distribution::ROUND_ROBIN;
+    double zipfTheta = 0.99;
+    double hotSetSize = 0.1;
+    double hotSetProbability = 0.9;
+    // percentage of payments for a customer of a remote warehouse
+    int16_t remotePayment = 15;
+    // percentage of order lines supplied by a remote warehouse
+    int16_t remoteStock = 1;
+    // NewOrder only returns success, o_id and total_amount
+    bool summaryOnly = false;
+    // milliseconds the server has for a transaction, 0 for no deadline
+    uint32_t deadline = 0;
+
+    // Both throw std::invalid_argument on malformed input
+    void parseMix(const std::string& mix);
+    void parseDistribution(const std::string& distribution);
+
+    Command pick(Random_t& rnd) const;
+};
+
+// Draws the home warehouse of the next transaction of one client
+class WarehouseChooser {
+    const Workload& mWorkload;
+    int16_t mNumWarehouses;
+    int16_t mLower;
+    int16_t mUpper;
+    int16_t mCurr;
+    // constants of the zipf generator from Gray et al., "Quickly generating
+    // billion-record synthetic databases"
+    double mZetaN = 0.0;
+    double mAlpha = 0.0;
+    double mEta = 0.0;
+    int16_t mHotWarehouses = 0;
+public:
+    WarehouseChooser(const Workload& workload, int16_t numWarehouses, int16_t lower, int16_t upper);
+    int16_t next(Random_t& rnd);
+};
+
+} // namespace tpcc
@@ -29,10 +29,20 @@
 #include <iostream>
 #include <cassert>
 #include <fstream>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
 
 #include <common/Util.hpp>
 
 #include "Client.hpp"
+#include "PopulateScheduler.hpp"
+#include "Reporter.hpp"
+#include "RequestStream.hpp"
+#include "SaturationSearch.hpp"
+#include "Workload.hpp"
 
 using namespace crossbow::program_options;
 using namespace boost::asio;
@@ -47,18 +57,97 @@ int main(int argc, const char** argv) {
     std::string port("8713");
     std::string logLevel("DEBUG");
     std::string outFile("out.csv");
+    std::string summaryFile("summary.csv");
+    bool rawLog = false;
+    unsigned reportInterval = 10;
+    std::string reportFile("report.csv");
     size_t numClients = 1;
+    unsigned numThreads = 1;
+    unsigned seed = 0;
     unsigned time = 5*60;
+    unsigned warmup = 0;
+    unsigned cooldown = 0;
+    double rate = 0;
+    std::string arrival("poisson");
+    std::string mix;
+    std::string warehouseDist("round-robin");
+    tpcc::Workload workload;
+    size_t pregenerate = 0;
+    std::string saveStreamsFile;
+    std::string loadStreamsFile;
+    std::string recordFile;
+    std::string replayFile;
+    double speed = 1.0;
+    bool saturate = false;
+    double sla = 100;
+    unsigned stepTime = 30;
+    double startRate = 100;
+    double rateStep = 100;
+    std::string saturationFile("saturation.csv");
     bool exit = false;
     auto opts = create_options("tpcc_client",
             value<'h'>("help", &help, tag::description{"print help"})
-            , value<'H'>("host", &host, tag::description{"Comma-separated list of hosts"})
+            , value<'H'>("host", &host, tag::description{"Comma-separated list of hosts, unix:<path> and shm:<path> connect locally"})
             , value<'l'>("log-level", &logLevel, tag::description{"The log level"})
             , value<'c'>("num-clients", &numClients, tag::description{"Number of Clients to run per host"})
+            , value<'T'>("threads", &numThreads, tag::description{"Number of threads the clients are spread over"})
+            , value<-1>("seed", &seed, tag::ignore_short<true>{},
+                        tag::description{"Seed for the input generators, 0 picks a random one"})
             , value<'P'>("populate", &populate, tag::description{"Populate the database"})
             , value<'W'>("num-warehouses", &numWarehouses, tag::description{"Number of warehouses"})
             , value<'t'>("time", &time, tag::description{"Duration of the benchmark in seconds"})
-            , value<'o'>("out", &outFile, tag::description{"Path to the output file"})
+            , value<-1>("warmup", &warmup, tag::ignore_short<true>{},
+                        tag::description{"Seconds at the beginning of the run that are not measured"})
+            , value<-1>("cooldown", &cooldown, tag::ignore_short<true>{},
+                        tag::description{"Seconds at the end of the run that are not measured"})
+            , value<'o'>("out", &outFile, tag::description{"Path to the raw log file (only written with --raw-log)"})
+            , value<-1>("raw-log", &rawLog, tag::ignore_short<true>{},
+                        tag::description{"Log every single transaction and write the log to the output file"})
+            , value<-1>("summary", &summaryFile, tag::ignore_short<true>{},
+                        tag::description{"Path to the summary file"})
+            , value<-1>("report-interval", &reportInterval, tag::ignore_short<true>{},
+                        tag::description{"Print throughput and latencies every N seconds, 0 disables reporting"})
+            , value<-1>("report-file", &reportFile, tag::ignore_short<true>{},
+                        tag::description{"CSV file the interval reports are appended to"})
+            , value<'r'>("rate", &rate, tag::description{"Target transactions per second over all clients (open loop), 0 runs closed loop"})
+            , value<-1>("arrival", &arrival, tag::ignore_short<true>{},
+                        tag::description{"Inter-arrival times in open loop mode: poisson or fixed"})
+            , value<-1>("pregenerate", &pregenerate, tag::ignore_short<true>{},
+                        tag::description{"Generate this many requests per client before the run, clients wrap around at the end"})
+            , value<-1>("save-streams", &saveStreamsFile, tag::ignore_short<true>{},
+                        tag::description{"Write the pre-generated requests of all clients to this file"})
+            , value<-1>("load-streams", &loadStreamsFile, tag::ignore_short<true>{},
+                        tag::description{"Send the requests from a file written with --save-streams"})
+            , value<-1>("record", &recordFile, tag::ignore_short<true>{},
+                        tag::description{"Write every sent request with its start time to this file"})
+            , value<-1>("replay", &replayFile, tag::ignore_short<true>{},
+                        tag::description{"Send the requests of a recording at their original times"})
+            , value<-1>("speed", &speed, tag::ignore_short<true>{},
+                        tag::description{"Speed factor for --replay, 2 replays twice as fast"})
+            , value<-1>("saturate", &saturate, tag::ignore_short<true>{},
+                        tag::description{"Ramp up the rate in steps until the p99 latency exceeds the SLA"})
+            , value<-1>("sla", &sla, tag::ignore_short<true>{},
+                        tag::description{"p99 latency SLA in milliseconds for --saturate"})
+            , value<-1>("step-time", &stepTime, tag::ignore_short<true>{},
+                        tag::description{"Seconds every step of --saturate runs"})
+            , value<-1>("start-rate", &startRate, tag::ignore_short<true>{},
+                        tag::description{"Transactions per second of the first step of --saturate"})
+            , value<-1>("rate-step", &rateStep, tag::ignore_short<true>{},
+                        tag::description{"Transactions per second added by every step of --saturate"})
+            , value<-1>("saturation-file", &saturationFile, tag::ignore_short<true>{},
+                        tag::description{"CSV file the load curve of --saturate is written to"})
+            , value<-1>("mix", &mix, tag::ignore_short<true>{},
+                        tag::description{"Weights of NewOrder,Payment,OrderStatus,Delivery,StockLevel (default 45,43,4,4,4)"})
+            , value<-1>("warehouse-dist", &warehouseDist, tag::ignore_short<true>{},
+                        tag::description{"Warehouse access distribution: round-robin, uniform, zipf[:theta] or hotset[:size[:probability]]"})
+            , value<-1>("remote-payment", &workload.remotePayment, tag::ignore_short<true>{},
+                        tag::description{"Percentage of payments for a customer of a remote warehouse"})
+            , value<-1>("remote-stock", &workload.remoteStock, tag::ignore_short<true>{},
+                        tag::description{"Percentage of order lines supplied by a remote warehouse"})
+            , value<-1>("summary-only", &workload.summaryOnly, tag::ignore_short<true>{},
+                        tag::description{"Let NewOrder only return success, order id and total amount"})
+            , value<-1>("deadline", &workload.deadline, tag::ignore_short<true>{},
+                        tag::description{"Milliseconds the server has for a transaction before rolling it back, 0 for none"})
             , value<-1>("exit", &exit, tag::description{"Quit server"})
             , value<'a'>("ch-bench-analytics", &useCHTables,
                          tag::description{"Populate the database witht he additional tables used in the CHBenchmark"})
@@ -78,37 +167,100 @@ int main(int argc, const char** argv) {
         std::cerr << "No host\n";
         return 1;
     }
+    if (arrival != "poisson" && arrival != "fixed") {
+        std::cerr << "Unknown arrival distribution " << arrival << std::endl;
+        return 1;
+    }
+    try {
+        if (!mix.empty()) workload.parseMix(mix);
+        workload.parseDistribution(warehouseDist);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (workload.remotePayment < 0 || workload.remotePayment > 100
+            || workload.remoteStock < 0 || workload.remoteStock > 100) {
+        std::cerr << "Remote percentages have to be between 0 and 100\n";
+        return 1;
+    }
+    if (!saveStreamsFile.empty() && pregenerate == 0) {
+        std::cerr << "--save-streams needs --pregenerate\n";
+        return 1;
+    }
+    if (!replayFile.empty() && (saturate || pregenerate > 0 || !loadStreamsFile.empty())) {
+        std::cerr << "--replay can not be combined with --saturate, --pregenerate or --load-streams\n";
+        return 1;
+    }
+    if (speed <= 0) {
+        std::cerr << "The replay speed has to be positive\n";
+        return 1;
+    }
+    if (saturate && (startRate <= 0 || rateStep <= 0 || stepTime == 0)) {
+        std::cerr << "--saturate needs a positive start rate, rate step and step time\n";
+        return 1;
+    }
+    if (warmup + cooldown >= time) {
+        std::cerr << "Warm-up and cool-down leave no time to measure\n";
+        return 1;
+    }
+    if (numThreads == 0) {
+        std::cerr << "Need at least one thread\n";
+        return 1;
+    }
+    if (populate || exit) {
+        // populating and exiting chain requests over all clients
+        numThreads = 1;
+    }
+    if (seed == 0) {
+        seed = std::random_device()();
+    }
     auto startTime = tpcc::Clock::now();
     auto endTime = startTime + std::chrono::seconds(time);
+    auto measureBegin = startTime;
+    auto measureEnd = endTime;
     crossbow::logger::logger->config.level = crossbow::logger::logLevelFromString(logLevel);
     try {
         auto hosts = tpcc::split(host.c_str(), ',');
-        io_service service;
         auto sumClients = hosts.size() * numClients;
+        // every thread runs its own io_service, a client stays on the thread it is assigned to
+        numThreads = unsigned(std::min(size_t(numThreads), std::min(sumClients, size_t(numWarehouses))));
+        std::vector<std::unique_ptr<io_service>> services;
+        std::vector<std::unique_ptr<tpcc::Statistics>> stats;
+        for (unsigned i = 0; i < numThreads; ++i) {
+            services.emplace_back(new io_service());
+            stats.emplace_back(new tpcc::Statistics());
+        }
+        auto& service = *services[0];
+        std::unique_ptr<tpcc::Reporter> reporter;
+        std::unique_ptr<tpcc::SaturationSearch> search;
+        std::unique_ptr<tpcc::PopulateScheduler> populator;
         std::vector<tpcc::Client> clients;
         clients.reserve(sumClients);
         auto wareHousesPerClient = numWarehouses / sumClients;
+        auto activeClients = std::min(sumClients, size_t(numWarehouses));
+        tpcc::LoadControl load((saturate ? startRate : rate) / activeClients);
         for (decltype(sumClients) i = 0; i < sumClients; ++i) {
             if (i >= unsigned(numWarehouses)) break;
             int16_t lastWarehouse =  wareHousesPerClient * (i + 1);
             if (i == sumClients - 1) lastWarehouse = numWarehouses;
-            clients.emplace_back(service, numWarehouses, int16_t(wareHousesPerClient * i + 1), lastWarehouse, endTime);
+            auto thread = i % numThreads;
+            clients.emplace_back(*services[thread], numWarehouses, int16_t(wareHousesPerClient * i + 1), lastWarehouse,
+                    workload, load, arrival == "poisson", *stats[thread], rawLog, seed + unsigned(i));
         }
         for (size_t i = 0; i < hosts.size(); ++i) {
             auto h = hosts[i];
-            auto addr = tpcc::split(h, ':');
-            assert(addr.size() <= 2);
-            auto p = addr.size() == 2 ? addr[1] : port;
-            ip::tcp::resolver resolver(service);
-            ip::tcp::resolver::iterator iter;
-            if (host == "") {
-                iter = resolver.resolve(ip::tcp::resolver::query(p));
-            } else {
-                iter = resolver.resolve(ip::tcp::resolver::query(addr[0], p));
+            auto p = port;
+            // unix:<path> and shm:<path> name a local server, there is no port
+            if (h.compare(0, 5, "unix:") != 0 && h.compare(0, 4, "shm:") != 0) {
+                auto addr = tpcc::split(h, ':');
+                assert(addr.size() <= 2);
+                h = addr[0];
+                if (addr.size() == 2) p = addr[1];
             }
             for (unsigned j = 0; j < numClients; ++j) {
+                auto& conn = clients[i*numClients + j].connection();
+                conn.reset(tpcc::connectTransport(conn.get_io_service(), h, p));
                 LOG_INFO("Connected to client " + crossbow::to_string(i*numClients + j));
-                boost::asio::connect(clients[i*numClients + j].socket(), iter);
             }
         }
 
@@ -133,47 +285,126 @@ int main(int argc, const char** argv) {
         }
 
         if (populate) {
-            auto& cmds = clients[0].commands();
             std::cout << "numWarehouses=" << numWarehouses << std::endl;
-            cmds.execute<tpcc::Command::CREATE_SCHEMA>(
-                    [&clients, &useCHTables, numWarehouses](const err_code& ec,
-                        const std::tuple<bool, crossbow::string>& res){
-                LOG_INFO("Created schema.");
-                if (ec) {
-                    LOG_ERROR(ec.message());
-                    return;
+            std::vector<tpcc::Client*> connections;
+            for (auto& client : clients) {
+                connections.push_back(&client);
+            }
+            populator.reset(new tpcc::PopulateScheduler(std::move(connections), numWarehouses, useCHTables));
+            populator->run();
+        } else {
+            if (!replayFile.empty()) {
+                auto recording = tpcc::loadRecording(replayFile);
+                // requests of the same recorded connection stay on the same connection
+                std::vector<std::vector<tpcc::Request>> requests(clients.size());
+                std::vector<std::vector<tpcc::Clock::duration>> schedules(clients.size());
+                for (const auto& r : recording) {
+                    auto i = r.connection % clients.size();
+                    requests[i].push_back(r.request);
+                    schedules[i].push_back(std::chrono::duration_cast<tpcc::Clock::duration>(
+                                std::chrono::duration<double, std::micro>(double(r.offset) / speed)));
                 }
-                if (!std::get<0>(res)) {
-                    LOG_ERROR(std::get<1>(res));
-                    return;
+                for (size_t i = 0; i < clients.size(); ++i) {
+                    clients[i].setReplay(tpcc::RequestStream(std::move(requests[i])), std::move(schedules[i]));
                 }
-
-                auto& cmds = clients[0].commands();
-                cmds.execute<tpcc::Command::POPULATE_DIM_TABLES>([&clients, &useCHTables](const err_code& ec, const std::tuple<bool, crossbow::string>& res){
-                    LOG_INFO("Populated dim tables.");
-                    if (ec) {
-                        LOG_ERROR(ec.message());
-                        return;
-                    }
-                    if (!std::get<0>(res)) {
-                        LOG_ERROR(std::get<1>(res));
-                        return;
-                    }
-
-                    for (auto& client : clients) {
-                        client.populate(useCHTables);
-                    }
-                    
-                }, useCHTables);
-            }, std::make_tuple(int16_t(numWarehouses), useCHTables));
-        } else {
+                LOG_INFO("Replaying %1% requests from %2%", recording.size(), replayFile);
+            } else if (!loadStreamsFile.empty()) {
+                auto streams = tpcc::loadStreams(loadStreamsFile);
+                if (streams.size() != clients.size()) {
+                    throw std::runtime_error(loadStreamsFile + " has " + std::to_string(streams.size())
+                            + " streams but there are " + std::to_string(clients.size()) + " clients");
+                }
+                for (size_t i = 0; i < clients.size(); ++i) {
+                    clients[i].setStream(std::move(streams[i]));
+                }
+                LOG_INFO("Loaded request streams from %1%", loadStreamsFile);
+            } else if (pregenerate > 0) {
+                for (auto& client : clients) {
+                    client.pregenerate(pregenerate);
+                }
+                LOG_INFO("Generated %1% requests per client", pregenerate);
+            }
+            if (!saveStreamsFile.empty()) {
+                std::vector<const tpcc::RequestStream*> streams;
+                for (const auto& client : clients) {
+                    streams.push_back(&client.stream());
+                }
+                tpcc::saveStreams(saveStreamsFile, streams);
+            }
+            // generating the streams may take a while, the benchmark starts now
+            startTime = tpcc::Clock::now();
+            endTime = startTime + std::chrono::seconds(time);
+            measureBegin = startTime + std::chrono::seconds(warmup);
+            measureEnd = endTime - std::chrono::seconds(cooldown);
+            for (auto& s : stats) {
+                s->setWindow(measureBegin, measureEnd);
+            }
             for (decltype(clients.size()) i = 0; i < clients.size(); ++i) {
                 auto& client = clients[i];
-                client.run();
+                client.setRecording(!recordFile.empty());
+                client.run(endTime);
+            }
+            std::vector<tpcc::Statistics*> threadStats;
+            for (auto& s : stats) {
+                threadStats.push_back(s.get());
+            }
+            if (saturate) {
+                search.reset(new tpcc::SaturationSearch(service, std::move(threadStats), load, activeClients,
+                            startRate, rateStep, std::chrono::seconds(stepTime),
+                            std::chrono::microseconds(int64_t(sla * 1000.0)), endTime, saturationFile));
+                search->run();
+            } else if (reportInterval > 0) {
+                reporter.reset(new tpcc::Reporter(service, std::move(threadStats), std::chrono::seconds(reportInterval),
+                            reportFile, startTime, endTime));
+                reporter->run();
             }
         }
 END:
-        service.run();
+        {
+            std::vector<std::thread> threads;
+            for (unsigned i = 1; i < numThreads; ++i) {
+                threads.emplace_back([&services, i]() { services[i]->run(); });
+            }
+            service.run();
+            for (auto& t : threads) {
+                t.join();
+            }
+        }
+        if (populator && populator->failed() > 0) {
+            std::cerr << "Population failed" << std::endl;
+            return 1;
+        }
+        if (!recordFile.empty()) {
+            std::vector<tpcc::RecordedRequest> recording;
+            for (size_t i = 0; i < clients.size(); ++i) {
+                for (const auto& e : clients[i].recorded()) {
+                    tpcc::RecordedRequest r;
+                    r.offset = std::chrono::duration_cast<std::chrono::microseconds>(e.first - startTime).count();
+                    r.connection = uint32_t(i);
+                    r.reserved = 0;
+                    r.request = e.second;
+                    recording.push_back(r);
+                }
+            }
+            std::stable_sort(recording.begin(), recording.end(),
+                    [](const tpcc::RecordedRequest& a, const tpcc::RecordedRequest& b) { return a.offset < b.offset; });
+            tpcc::saveRecording(recordFile, recording);
+            LOG_INFO("Recorded %1% requests to %2%", recording.size(), recordFile);
+        }
+        if (!populate && !exit && !saturate) {
+            tpcc::Statistics::Snapshot total;
+            for (const auto& s : stats) {
+                tpcc::merge(total, s->total());
+            }
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(measureEnd - measureBegin);
+            tpcc::writeSummary(std::cout, total, duration);
+            std::ofstream summary(summaryFile.c_str());
+            tpcc::writeSummary(summary, total, duration);
+        }
+        if (!rawLog) {
+            std::cout << '\a';
+            return 0;
+        }
         LOG_INFO("Done, writing results");
         std::ofstream out(outFile.c_str());
         out << "start,end,transaction,success,error\n";
@@ -0,0 +1,23 @@
+# - Find liburing
+
+# Look for the liburing header
+find_path(LibUring_INCLUDE_DIR
+        NAMES liburing.h
+        HINTS ${LibUring_ROOT} ENV LibUring_ROOT
+        PATH_SUFFIXES include)
+
+# Look for the liburing library
+find_library(LibUring_LIBRARY
+        NAMES uring
+        HINTS ${LibUring_ROOT} ENV LibUring_ROOT
+        PATH_SUFFIXES lib)
+
+set(LibUring_LIBRARIES ${LibUring_LIBRARY})
+set(LibUring_INCLUDE_DIRS ${LibUring_INCLUDE_DIR})
+
+mark_as_advanced(LibUring_INCLUDE_DIR LibUring_LIBRARY)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LibUring
+        FOUND_VAR LibUring_FOUND
+        REQUIRED_VARS LibUring_LIBRARY LibUring_INCLUDE_DIR)
@@ -0,0 +1,341 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <crossbow/Serializer.hpp>
+#include <crossbow/string.hpp>
+
+namespace tpcc {
+
+// Encoding of the protocol messages: trivially copyable types are copied
+// as they are, strings and vectors get a varint length prefix, tuples and
+// types marked with crossbow::is_serializable are encoded member by member.
+template<class T, class Enable = void>
+struct Archive;
+
+// Marks an integer to be encoded as varint (zigzag for signed types), so
+// small values take a single byte on the wire
+template<class T>
+struct VarInt {
+    static_assert(std::is_integral<T>::value, "Only integers can be encoded as varint");
+    T& value;
+};
+
+template<class T>
+VarInt<T> varint(T& value) {
+    return VarInt<T>{value};
+}
+
+// A string inside a received message, only valid as long as the buffer the
+// message was read from
+struct StringRef {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    crossbow::string str() const {
+        return size ? crossbow::string(data, size) : crossbow::string();
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& out, const StringRef& str) {
+    return out.write(str.data, str.size);
+}
+
+namespace impl {
+
+template<class T, class Enable = void>
+struct IsSerializable : std::false_type {};
+
+template<class T>
+struct IsSerializable<T, typename std::enable_if<
+        std::is_same<typename T::is_serializable, crossbow::is_serializable>::value>::type> : std::true_type {};
+
+template<class T>
+struct IsTuple : std::false_type {};
+
+template<class... T>
+struct IsTuple<std::tuple<T...>> : std::true_type {};
+
+template<class T>
+struct IsVarInt : std::false_type {};
+
+template<class T>
+struct IsVarInt<VarInt<T>> : std::true_type {};
+
+} // namespace impl
+
+// Growable output buffer, kept by every connection and reused for all
+// messages, so a message is serialized in one pass and memory is only
+// allocated when a message is larger than all before.
+class BufferWriter {
+    std::unique_ptr<uint8_t[]> mBuffer;
+    size_t mCapacity;
+    size_t mSize = 0;
+public:
+    explicit BufferWriter(size_t capacity = 1024)
+        : mBuffer(new uint8_t[capacity])
+        , mCapacity(capacity)
+    {}
+
+    void clear() {
+        mSize = 0;
+    }
+    const uint8_t* data() const {
+        return mBuffer.get();
+    }
+    size_t size() const {
+        return mSize;
+    }
+
+    void write(const void* data, size_t size) {
+        reserve(mSize + size);
+        memcpy(mBuffer.get() + mSize, data, size);
+        mSize += size;
+    }
+
+    // overwrites an already written value, used for length prefixes that
+    // are only known once the message is complete
+    template<class T>
+    void patch(size_t offset, const T& value) {
+        memcpy(mBuffer.get() + offset, &value, sizeof(T));
+    }
+
+    template<class T>
+    BufferWriter& operator&(const T& value) {
+        Archive<T>::write(*this, value);
+        return *this;
+    }
+private:
+    void reserve(size_t size) {
+        if (size <= mCapacity) return;
+        auto capacity = std::max(size, 2 * mCapacity);
+        std::unique_ptr<uint8_t[]> newBuf(new uint8_t[capacity]);
+        memcpy(newBuf.get(), mBuffer.get(), mSize);
+        mBuffer.swap(newBuf);
+        mCapacity = capacity;
+    }
+};
+
+// Reads a message written by a BufferWriter. Reading past the end of the
+// message does not fail immediately but sets failed().
+class BufferReader {
+    const uint8_t* mPos;
+    const uint8_t* mEnd;
+    bool mFailed = false;
+public:
+    BufferReader(const uint8_t* data, size_t size)
+        : mPos(data)
+        , mEnd(data + size)
+    {}
+
+    bool failed() const {
+        return mFailed;
+    }
+    size_t remaining() const {
+        return size_t(mEnd - mPos);
+    }
+
+    // returns the next size bytes or nullptr if the message is too short
+    const uint8_t* take(size_t size) {
+        if (mFailed || remaining() < size) {
+            mFailed = true;
+            return nullptr;
+        }
+        auto res = mPos;
+        mPos += size;
+        return res;
+    }
+
+    void read(void* data, size_t size) {
+        auto src = take(size);
+        if (src) {
+            memcpy(data, src, size);
+        } else {
+            memset(data, 0, size);
+        }
+    }
+
+    template<class T>
+    BufferReader& operator&(T& value) {
+        Archive<T>::read(*this, value);
+        return *this;
+    }
+
+    template<class T>
+    BufferReader& operator&(const VarInt<T>& value) {
+        Archive<VarInt<T>>::read(*this, const_cast<VarInt<T>&>(value));
+        return *this;
+    }
+};
+
+template<class T>
+struct Archive<T, typename std::enable_if<std::is_trivially_copyable<T>::value
+        && !impl::IsSerializable<T>::value && !impl::IsTuple<T>::value && !impl::IsVarInt<T>::value
+        && !std::is_same<T, StringRef>::value>::type> {
+    static void write(BufferWriter& out, const T& value) {
+        out.write(&value, sizeof(T));
+    }
+    static void read(BufferReader& in, T& value) {
+        in.read(&value, sizeof(T));
+    }
+};
+
+template<class T>
+struct Archive<T, typename std::enable_if<impl::IsSerializable<T>::value>::type> {
+    static void write(BufferWriter& out, const T& value) {
+        const_cast<T&>(value) & out;
+    }
+    static void read(BufferReader& in, T& value) {
+        value & in;
+    }
+};
+
+template<class T>
+struct Archive<VarInt<T>> {
+    using Unsigned = typename std::make_unsigned<T>::type;
+
+    static void write(BufferWriter& out, const VarInt<T>& v) {
+        auto value = Unsigned(v.value);
+        if (std::is_signed<T>::value) {
+            value = Unsigned(value << 1) ^ Unsigned(v.value < 0 ? ~Unsigned(0) : 0);
+        }
+        uint8_t buf[(sizeof(T) * 8 + 6) / 7];
+        size_t size = 0;
+        while (value >= 0x80) {
+            buf[size++] = uint8_t(value) | 0x80;
+            value >>= 7;
+        }
+        buf[size++] = uint8_t(value);
+        out.write(buf, size);
+    }
+
+    static void read(BufferReader& in, VarInt<T>& v) {
+        Unsigned value = 0;
+        for (unsigned shift = 0; shift < sizeof(T) * 8; shift += 7) {
+            auto byte = in.take(1);
+            if (!byte) break;
+            value |= Unsigned(*byte & 0x7f) << shift;
+            if (!(*byte & 0x80)) break;
+        }
+        if (std::is_signed<T>::value) {
+            value = Unsigned(value >> 1) ^ Unsigned(-(value & 1));
+        }
+        v.value = T(value);
+    }
+};
+
+template<>
+struct Archive<crossbow::string> {
+    static void write(BufferWriter& out, const crossbow::string& value) {
+        auto size = uint32_t(value.size());
+        out & varint(size);
+        out.write(value.c_str(), size);
+    }
+    static void read(BufferReader& in, crossbow::string& value) {
+        uint32_t size = 0;
+        in & varint(size);
+        auto data = in.take(size);
+        value = data ? crossbow::string(reinterpret_cast<const char*>(data), size) : crossbow::string();
+    }
+};
+
+// Encoded like crossbow::string, but reading does not copy
+template<>
+struct Archive<StringRef> {
+    static void write(BufferWriter& out, const StringRef& value) {
+        auto size = uint32_t(value.size);
+        out & varint(size);
+        out.write(value.data, size);
+    }
+    static void read(BufferReader& in, StringRef& value) {
+        uint32_t size = 0;
+        in & varint(size);
+        auto data = in.take(size);
+        value.data = reinterpret_cast<const char*>(data);
+        value.size = data ? size : 0;
+    }
+};
+
+template<class T>
+struct Archive<std::vector<T>> {
+    static void write(BufferWriter& out, const std::vector<T>& value) {
+        auto size = uint32_t(value.size());
+        out & varint(size);
+        for (const auto& e : value) {
+            out & e;
+        }
+    }
+    static void read(BufferReader& in, std::vector<T>& value) {
+        uint32_t size = 0;
+        in & varint(size);
+        // every element takes at least one byte, anything else is garbage
+        if (size > in.remaining()) {
+            in.take(in.remaining() + 1);
+            value.clear();
+            return;
+        }
+        value.resize(size);
+        for (auto& e : value) {
+            in & e;
+        }
+    }
+};
+
+template<class... T>
+struct Archive<std::tuple<T...>> {
+    template<size_t I>
+    static typename std::enable_if<I == sizeof...(T), void>::type writeAll(BufferWriter&, const std::tuple<T...>&) {}
+
+    template<size_t I>
+    static typename std::enable_if<I < sizeof...(T), void>::type writeAll(BufferWriter& out, const std::tuple<T...>& value) {
+        out & std::get<I>(value);
+        writeAll<I + 1>(out, value);
+    }
+
+    template<size_t I>
+    static typename std::enable_if<I == sizeof...(T), void>::type readAll(BufferReader&, std::tuple<T...>&) {}
+
+    template<size_t I>
+    static typename std::enable_if<I < sizeof...(T), void>::type readAll(BufferReader& in, std::tuple<T...>& value) {
+        in & std::get<I>(value);
+        readAll<I + 1>(in, value);
+    }
+
+    static void write(BufferWriter& out, const std::tuple<T...>& value) {
+        writeAll<0>(out, value);
+    }
+    static void read(BufferReader& in, std::tuple<T...>& value) {
+        readAll<0>(in, value);
+    }
+};
+
+} // namespace tpcc
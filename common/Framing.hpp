@@ -0,0 +1,121 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+
+#include <boost/system/error_code.hpp>
+#include <boost/asio.hpp>
+
+namespace tpcc {
+
+// Reads length prefixed frames ([size_t size][payload], size includes the
+// header) from a stream into one reusable buffer. Every read asks for at
+// least the missing bytes of the current frame but takes whatever else is
+// available, so frames that arrive together are handed out without another
+// read.
+template<class Stream>
+class FrameReader {
+public:
+    static constexpr size_t HEADER_SIZE = sizeof(size_t);
+    // the size comes from the peer, larger frames fail the read instead of
+    // allocating whatever a corrupt header asks for
+    static constexpr size_t MAX_FRAME_SIZE = size_t(16) << 20;
+private:
+    Stream& mStream;
+    std::unique_ptr<uint8_t[]> mBuffer;
+    size_t mCapacity;
+    // the unconsumed bytes are [mBegin, mEnd)
+    size_t mBegin = 0;
+    size_t mEnd = 0;
+public:
+    FrameReader(Stream& stream, size_t capacity = 1024)
+        : mStream(stream)
+        , mBuffer(new uint8_t[capacity])
+        , mCapacity(capacity)
+    {}
+
+    // Calls handler(ec, payload, size) with the next complete frame. The
+    // payload stays valid until read() is called again.
+    template<class Handler>
+    void read(const Handler& handler) {
+        auto buffered = mEnd - mBegin;
+        size_t size = HEADER_SIZE;
+        if (buffered >= HEADER_SIZE) {
+            memcpy(&size, mBuffer.get() + mBegin, HEADER_SIZE);
+            if (size < HEADER_SIZE || size > MAX_FRAME_SIZE) {
+                handler(boost::asio::error::invalid_argument, nullptr, 0);
+                return;
+            }
+            if (buffered >= size) {
+                const uint8_t* payload = mBuffer.get() + mBegin + HEADER_SIZE;
+                mBegin += size;
+                if (mBegin == mEnd) {
+                    mBegin = mEnd = 0;
+                }
+                handler(boost::system::error_code(), payload, size - HEADER_SIZE);
+                return;
+            }
+        }
+        reserve(size);
+        boost::asio::async_read(mStream,
+                boost::asio::buffer(mBuffer.get() + mEnd, mCapacity - mEnd),
+                boost::asio::transfer_at_least(size - buffered),
+                [this, handler](const boost::system::error_code& ec, size_t bytesRead) {
+                    if (ec) {
+                        handler(ec, nullptr, 0);
+                        return;
+                    }
+                    mEnd += bytesRead;
+                    read(handler);
+                });
+    }
+private:
+    // makes sure a frame of the given size fits behind mBegin
+    void reserve(size_t size) {
+        if (mCapacity - mBegin >= size) return;
+        auto buffered = mEnd - mBegin;
+        if (mCapacity < size) {
+            auto capacity = std::max(size, 2 * mCapacity);
+            std::unique_ptr<uint8_t[]> newBuf(new uint8_t[capacity]);
+            memcpy(newBuf.get(), mBuffer.get() + mBegin, buffered);
+            mBuffer.swap(newBuf);
+            mCapacity = capacity;
+        } else {
+            memmove(mBuffer.get(), mBuffer.get() + mBegin, buffered);
+        }
+        mBegin = 0;
+        mEnd = buffered;
+    }
+};
+
+template<class Stream>
+constexpr size_t FrameReader<Stream>::HEADER_SIZE;
+
+template<class Stream>
+constexpr size_t FrameReader<Stream>::MAX_FRAME_SIZE;
+
+} // namespace tpcc
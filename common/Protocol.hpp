@@ -23,15 +23,21 @@
 #pragma once
 #include <tuple>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <type_traits>
+#include <vector>
 
 #include <boost/system/error_code.hpp>
 #include <boost/asio.hpp>
 #include <boost/preprocessor.hpp>
 
-#include <crossbow/Serializer.hpp>
 #include <crossbow/string.hpp>
 
+#include "Archive.hpp"
+#include "Framing.hpp"
+#include "Transport.hpp"
+
 #define GEN_COMMANDS_ARR(Name, arr) enum class Name {\
     BOOST_PP_ARRAY_ELEM(0, arr) = 1, \
     BOOST_PP_ARRAY_ENUM(BOOST_PP_ARRAY_REMOVE(arr, 0)) \
@@ -89,12 +95,29 @@ struct Signature<Command::EXIT> {
     using arguments = void;
 };
 
+// Every transaction request carries a deadline_ms: the milliseconds the server
+// has from receiving the request until the transaction commits, 0 for no
+// deadline. It is relative so client and server clocks need not agree. A
+// transaction that misses it is rolled back and answered with TIMEOUT.
 struct NewOrderIn {
     int16_t w_id;
     int16_t d_id;
     int32_t c_id;
+    int16_t remote_stock_pct; // percentage of order lines supplied by a remote warehouse
+    bool summary_only;        // only send back success, o_id and total_amount
+    uint32_t deadline_ms;
 };
 
+// Results start with a flags byte, the error message is only sent if the
+// transaction failed and integers are sent as varints
+namespace result_flags {
+constexpr uint8_t SUCCESS = 1;
+constexpr uint8_t SUMMARY_ONLY = 2;
+constexpr uint8_t TIMEOUT = 4;
+// the server rejected the transaction without running it
+constexpr uint8_t OVERLOADED = 8;
+}
+
 struct NewOrderResult {
     using is_serializable = crossbow::is_serializable;
     struct OrderLine {
@@ -110,17 +133,20 @@ struct NewOrderResult {
 
         template<class Archiver>
         void operator&(Archiver& ar) {
-            ar & ol_supply_w_id;
-            ar & ol_i_id;
+            ar & varint(ol_supply_w_id);
+            ar & varint(ol_i_id);
             ar & i_name;
-            ar & ol_quantity;
-            ar & s_quantity;
+            ar & varint(ol_quantity);
+            ar & varint(s_quantity);
             ar & brand_generic;
-            ar & i_price;
-            ar & ol_amount;
+            ar & varint(i_price);
+            ar & varint(ol_amount);
         }
     };
     bool success = true;
+    bool summary_only = false;
+    bool timed_out = false;
+    bool overloaded = false;
     crossbow::string error;
     int32_t o_id;
     int16_t o_ol_cnt;
@@ -135,17 +161,27 @@ struct NewOrderResult {
 
     template<class Archiver>
     void operator&(Archiver& ar) {
-        ar & success;
-        ar & error;
-        ar & o_id;
-        ar & o_ol_cnt;
+        uint8_t flags = (success ? result_flags::SUCCESS : 0) | (summary_only ? result_flags::SUMMARY_ONLY : 0)
+            | (timed_out ? result_flags::TIMEOUT : 0) | (overloaded ? result_flags::OVERLOADED : 0);
+        ar & flags;
+        success = flags & result_flags::SUCCESS;
+        summary_only = flags & result_flags::SUMMARY_ONLY;
+        timed_out = flags & result_flags::TIMEOUT;
+        overloaded = flags & result_flags::OVERLOADED;
+        if (!success) {
+            ar & error;
+            return;
+        }
+        ar & varint(o_id);
+        ar & varint(total_amount);
+        if (summary_only) return;
+        ar & varint(o_ol_cnt);
         ar & c_last;
         ar & c_credit;
-        ar & c_discount;
-        ar & w_tax;
-        ar & d_tax;
-        ar & o_entry_d;
-        ar & total_amount;
+        ar & varint(c_discount);
+        ar & varint(w_tax);
+        ar & varint(d_tax);
+        ar & varint(o_entry_d);
         ar & lines;
     }
 };
@@ -166,6 +202,7 @@ struct PaymentIn {
     int16_t c_d_id;
     crossbow::string c_last;
     int32_t h_amount;
+    uint32_t deadline_ms;
 
     template<class Archiver>
     void operator&(Archiver& ar) {
@@ -177,18 +214,26 @@ struct PaymentIn {
         ar & c_d_id;
         ar & c_last;
         ar & h_amount;
+        ar & deadline_ms;
     }
 };
 
 struct PaymentResult {
     using is_serializable = crossbow::is_serializable;
     bool success = true;
+    bool timed_out = false;
+    bool overloaded = false;
     crossbow::string error;
 
     template<class Archiver>
     void operator&(Archiver& ar) {
-        ar & success;
-        ar & error;
+        uint8_t flags = (success ? result_flags::SUCCESS : 0) | (timed_out ? result_flags::TIMEOUT : 0)
+            | (overloaded ? result_flags::OVERLOADED : 0);
+        ar & flags;
+        success = flags & result_flags::SUCCESS;
+        timed_out = flags & result_flags::TIMEOUT;
+        overloaded = flags & result_flags::OVERLOADED;
+        if (!success) ar & error;
     }
 };
 
@@ -205,6 +250,7 @@ struct OrderStatusIn {
     int16_t d_id;
     int32_t c_id;
     crossbow::string c_last;
+    uint32_t deadline_ms;
 
     template<class A>
     void operator&(A& ar) {
@@ -213,18 +259,26 @@ struct OrderStatusIn {
         ar & d_id;
         ar & c_id;
         ar & c_last;
+        ar & deadline_ms;
     }
 };
 
 struct OrderStatusResult {
     using is_serializable = crossbow::is_serializable;
     bool success;
+    bool timed_out = false;
+    bool overloaded = false;
     crossbow::string error;
 
     template<class A>
     void operator&(A& ar) {
-        ar & success;
-        ar & error;
+        uint8_t flags = (success ? result_flags::SUCCESS : 0) | (timed_out ? result_flags::TIMEOUT : 0)
+            | (overloaded ? result_flags::OVERLOADED : 0);
+        ar & flags;
+        success = flags & result_flags::SUCCESS;
+        timed_out = flags & result_flags::TIMEOUT;
+        overloaded = flags & result_flags::OVERLOADED;
+        if (!success) ar & error;
     }
 };
 
@@ -237,19 +291,30 @@ struct Signature<Command::ORDER_STATUS> {
 struct DeliveryIn {
     int16_t w_id;
     int16_t o_carrier_id;
+    uint32_t deadline_ms;
 };
 
 struct DeliveryResult {
     using is_serializable = crossbow::is_serializable;
     bool success;
+    bool timed_out = false;
+    bool overloaded = false;
     crossbow::string error;
     int32_t low_stock;
+    // bit d_id - 1 is set if the district had no new order to deliver,
+    // only used by the deferred delivery log and not sent to the client
+    uint16_t skipped_districts = 0;
 
     template<class A>
     void operator& (A& ar) {
-        ar & success;
-        ar & error;
-        ar & low_stock;
+        uint8_t flags = (success ? result_flags::SUCCESS : 0) | (timed_out ? result_flags::TIMEOUT : 0)
+            | (overloaded ? result_flags::OVERLOADED : 0);
+        ar & flags;
+        success = flags & result_flags::SUCCESS;
+        timed_out = flags & result_flags::TIMEOUT;
+        overloaded = flags & result_flags::OVERLOADED;
+        if (!success) ar & error;
+        ar & varint(low_stock);
     }
 };
 
@@ -263,19 +328,27 @@ struct StockLevelIn {
     int16_t w_id;
     int16_t d_id;
     int32_t threshold;
+    uint32_t deadline_ms;
 };
 
 struct StockLevelResult {
     using is_serializable = crossbow::is_serializable;
     bool success;
+    bool timed_out = false;
+    bool overloaded = false;
     crossbow::string error;
     int32_t low_stock;
 
     template<class A>
     void operator& (A& ar) {
-        ar & success;
-        ar & error;
-        ar & low_stock;
+        uint8_t flags = (success ? result_flags::SUCCESS : 0) | (timed_out ? result_flags::TIMEOUT : 0)
+            | (overloaded ? result_flags::OVERLOADED : 0);
+        ar & flags;
+        success = flags & result_flags::SUCCESS;
+        timed_out = flags & result_flags::TIMEOUT;
+        overloaded = flags & result_flags::OVERLOADED;
+        if (!success) ar & error;
+        ar & varint(low_stock);
     }
 };
 
@@ -287,6 +360,77 @@ struct Signature<Command::STOCK_LEVEL> {
 
 namespace impl {
 
+// transaction results start with the result flags and carry an error message
+template<class T, class Enable = void>
+struct HasResultFlags : std::false_type {};
+
+template<class T>
+struct HasResultFlags<T, typename std::enable_if<std::is_same<decltype(T::success), bool>::value
+        && std::is_same<decltype(T::error), crossbow::string>::value>::type> : std::true_type {};
+
+} // namespace impl
+
+// What the client gets for a transaction result: a view into the receive
+// buffer of which only the flags and the error message are read when the
+// response arrives. The rest (e.g. the order lines of a NewOrder) is only
+// decoded if somebody asks for it with decode(). A view is only valid inside
+// the callback it is passed to.
+template<class Result>
+class ResultView {
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+    uint8_t mFlags = 0;
+    StringRef mError;
+public:
+    // false if the message is malformed
+    bool parse(const uint8_t* data, size_t size) {
+        mData = data;
+        mSize = size;
+        BufferReader in(data, size);
+        in & mFlags;
+        if (!success()) {
+            in & mError;
+        }
+        return !in.failed();
+    }
+
+    bool success() const {
+        return mFlags & result_flags::SUCCESS;
+    }
+    bool summaryOnly() const {
+        return mFlags & result_flags::SUMMARY_ONLY;
+    }
+    // the transaction was rolled back because it missed its deadline
+    bool timedOut() const {
+        return mFlags & result_flags::TIMEOUT;
+    }
+    // the server rejected the transaction without running it
+    bool overloaded() const {
+        return mFlags & result_flags::OVERLOADED;
+    }
+    const StringRef& error() const {
+        return mError;
+    }
+
+    // decodes the complete result, false if the message is malformed
+    bool decode(Result& result) const {
+        BufferReader in(mData, mSize);
+        in & result;
+        return !in.failed();
+    }
+};
+
+// The type a client callback gets for the result of a command
+template<class Result>
+using Response = typename std::conditional<impl::HasResultFlags<Result>::value, ResultView<Result>, Result>::type;
+
+// Fixed size arguments are copied into the request with a single memcpy
+static_assert(std::is_trivially_copyable<NewOrderIn>::value, "NewOrderIn has to be trivially copyable");
+static_assert(std::is_trivially_copyable<DeliveryIn>::value, "DeliveryIn has to be trivially copyable");
+static_assert(std::is_trivially_copyable<StockLevelIn>::value, "StockLevelIn has to be trivially copyable");
+
+namespace impl {
+
 template<class... Args>
 struct ArgSerializer;
 
@@ -327,59 +471,49 @@ struct argsType<> {
 };
 
 class CommandsImpl {
-    boost::asio::ip::tcp::socket& mSocket;
-    size_t mCurrSize = 1024;
-    std::unique_ptr<uint8_t[]> mCurrentRequest;
+    TransportStream& mStream;
+    BufferWriter mRequest;
+    FrameReader<TransportStream> mReader;
 public:
-    CommandsImpl(boost::asio::ip::tcp::socket& socket)
-        : mSocket(socket), mCurrentRequest(new uint8_t[mCurrSize])
+    CommandsImpl(TransportStream& stream)
+        : mStream(stream), mReader(stream)
     {
     }
 
     template<class Callback, class Result>
     typename std::enable_if<std::is_void<Result>::value, void>::type
-    readResponse(const Callback& callback, size_t bytes_read = 0) {
-        assert(bytes_read <= 1);
-        if (bytes_read) {
-            boost::system::error_code noError;
-            callback(noError);
-        }
-        mSocket.async_read_some(boost::asio::buffer(mCurrentRequest.get(), mCurrSize),
-                [this, callback, bytes_read](const boost::system::error_code& ec, size_t br){
-                    if (ec) {
-                        error<Result>(ec, callback);
-                        return;
-                    }
-                    readResponse<Callback, Result>(callback, bytes_read + br);
-                });
+    readResponse(const Callback& callback) {
+        mReader.read([this, callback](const boost::system::error_code& ec, const uint8_t*, size_t) {
+            callback(ec);
+        });
     }
 
     template<class Callback, class Result>
-    typename std::enable_if<!std::is_void<Result>::value, void>::type
-    readResponse(const Callback& callback, size_t bytes_read = 0) {
-        auto respSize = *reinterpret_cast<size_t*>(mCurrentRequest.get());
-        if (bytes_read >= 8 && respSize == bytes_read) {
-            // response read
+    typename std::enable_if<impl::HasResultFlags<Result>::value, void>::type
+    readResponse(const Callback& callback) {
+        mReader.read([this, callback](boost::system::error_code ec, const uint8_t* payload, size_t size) {
+            ResultView<Result> res;
+            if (!ec && !res.parse(payload, size)) {
+                ec = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+            }
+            callback(ec, res);
+        });
+    }
+
+    template<class Callback, class Result>
+    typename std::enable_if<!std::is_void<Result>::value && !impl::HasResultFlags<Result>::value, void>::type
+    readResponse(const Callback& callback) {
+        mReader.read([this, callback](boost::system::error_code ec, const uint8_t* payload, size_t size) {
             Result res;
-            boost::system::error_code noError;
-            crossbow::deserializer ser(mCurrentRequest.get() + sizeof(size_t));
-            ser & res;
-            callback(noError, res);
-            return;
-        } else if (bytes_read >= 8 && respSize > mCurrSize) {
-            std::unique_ptr<uint8_t[]> newBuf(new uint8_t[respSize]);
-            memcpy(newBuf.get(), mCurrentRequest.get(), mCurrSize);
-            mCurrentRequest.swap(newBuf);
-        }
-        mSocket.async_read_some(boost::asio::buffer(mCurrentRequest.get() + bytes_read, mCurrSize - bytes_read),
-                [this, callback, bytes_read](const boost::system::error_code& ec, size_t br){
-                    if (ec) {
-                        Result res;
-                        callback(ec, res);
-                        return;
-                    }
-                    readResponse<Callback, Result>(callback, bytes_read + br);
-                });
+            if (!ec) {
+                BufferReader in(payload, size);
+                in & res;
+                if (in.failed()) {
+                    ec = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+                }
+            }
+            callback(ec, res);
+        });
     }
 
     template<class Res, class Callback>
@@ -391,7 +525,7 @@ public:
     template<class Res, class Callback>
     typename std::enable_if<!std::is_void<Res>::value, void>::type
     error(const boost::system::error_code& ec, const Callback& callback) {
-        Res res;
+        Response<Res> res;
         callback(ec, res);
     }
 
@@ -402,21 +536,14 @@ public:
                 std::is_same<typename Signature<C>::arguments, typename argsType<Args...>::type>::value,
                 "Wrong function arguments");
         using ResType = typename Signature<C>::result;
-        crossbow::sizer sizer;
-        sizer & sizer.size;
-        sizer & C;
+        // the frame size is patched in once the request is serialized
+        mRequest.clear();
+        mRequest & size_t(0);
+        mRequest & C;
         impl::ArgSerializer<Args...> argSerializer;
-        argSerializer.exec(sizer, args...);
-        if (mCurrSize < sizer.size) {
-            mCurrentRequest.reset(new uint8_t[sizer.size]);
-            mCurrSize = sizer.size;
-        }
-        crossbow::serializer ser(mCurrentRequest.get());
-        ser & sizer.size;
-        ser & C;
-        argSerializer.exec(ser, args...);
-        ser.buffer.release();
-        boost::asio::async_write(mSocket, boost::asio::buffer(mCurrentRequest.get(), sizer.size),
+        argSerializer.exec(mRequest, args...);
+        mRequest.patch(0, mRequest.size());
+        boost::asio::async_write(mStream, boost::asio::buffer(mRequest.data(), mRequest.size()),
                     [this, callback](const boost::system::error_code& ec, size_t){
                         if (ec) {
                             error<ResType>(ec, callback);
@@ -434,16 +561,33 @@ namespace server {
 template<class Implementation>
 class Server {
     Implementation& mImpl;
-    boost::asio::ip::tcp::socket& mSocket;
-    size_t mBufSize = 1024;
-    std::unique_ptr<uint8_t[]> mBuffer;
+    TransportStream& mStream;
+    FrameReader<TransportStream> mReader;
+    // payload of the request that is currently executed
+    const uint8_t* mRequest = nullptr;
+    size_t mRequestSize = 0;
     using error_code = boost::system::error_code;
+    using ResponsePtr = std::unique_ptr<BufferWriter>;
     bool doQuit = false;
+    // guards everything below, handlers of one connection may run on
+    // different threads
+    std::mutex mMutex;
+    // Responses are serialized into buffers of this pool and queued. All queued
+    // responses are written with one gathering write, while that is in flight
+    // new ones queue up behind it.
+    std::vector<ResponsePtr> mPool;
+    std::vector<ResponsePtr> mQueued;
+    std::vector<ResponsePtr> mWriting;
+    std::vector<boost::asio::const_buffer> mWriteBuffers;
+    // reads, writes and executing requests that still use this connection, it
+    // is only closed once all of them are done
+    unsigned mPending = 0;
+    bool mFailed = false;
 public:
-    Server(Implementation& impl, boost::asio::ip::tcp::socket& socket)
+    Server(Implementation& impl, TransportStream& stream)
         : mImpl(impl)
-        , mSocket(socket)
-        , mBuffer(new uint8_t[mBufSize])
+        , mStream(stream)
+        , mReader(stream)
     {}
     void run() {
         read();
@@ -463,26 +607,23 @@ private:
     execute(Callback callback) {
         using Args = typename Signature<C>::arguments;
         Args args;
-        crossbow::deserializer des(mBuffer.get() + sizeof(size_t) + sizeof(Command));
-        des & args;
+        BufferReader in(mRequest + sizeof(Command), mRequestSize - sizeof(Command));
+        in & args;
+        if (in.failed()) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            fail(lock, "Malformed request");
+            return;
+        }
         mImpl.template execute<C>(args, callback);
     }
 
     template<Command C>
     typename std::enable_if<std::is_void<typename Signature<C>::result>::value, void>::type execute() {
         execute<C>([this]() {
-            // send the result back
-            mBuffer[0] = 1;
-            boost::asio::async_write(mSocket,
-                    boost::asio::buffer(mBuffer.get(), 1),
-                    [this](const error_code& ec, size_t bytes_written) {
-                        if (ec) {
-                            std::cerr << ec.message() << std::endl;
-                            return;
-                        }
-                        read(0);
-                    }
-            );
+            // send back a frame without payload
+            auto response = responseBuffer();
+            *response & sizeof(size_t);
+            send(std::move(response));
         });
     }
 
@@ -490,61 +631,113 @@ private:
     typename std::enable_if<!std::is_void<typename Signature<C>::result>::value, void>::type execute() {
         using Res = typename Signature<C>::result;
         execute<C>([this](const Res& result) {
-            // Serialize result
-            crossbow::sizer sizer;
-            sizer & sizer.size;
-            sizer & result;
-            if (mBufSize < sizer.size) {
-                mBuffer.reset(new uint8_t[sizer.size]);
+            // Serialize result, the frame size is patched in afterwards
+            auto response = responseBuffer();
+            *response & size_t(0);
+            *response & result;
+            response->patch(0, response->size());
+            send(std::move(response));
+        });
+    }
+
+    ResponsePtr responseBuffer() {
+        std::lock_guard<std::mutex> _(mMutex);
+        if (mPool.empty()) {
+            return ResponsePtr(new BufferWriter());
+        }
+        auto res = std::move(mPool.back());
+        mPool.pop_back();
+        res->clear();
+        return res;
+    }
+
+    // Queues the response of the request that finished executing and starts
+    // reading the next one while the response is still being written
+    void send(ResponsePtr response) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mFailed) {
+            mPool.push_back(std::move(response));
+            release(lock);
+            return;
+        }
+        mQueued.push_back(std::move(response));
+        if (mWriting.empty()) {
+            flush();
+        }
+        --mPending;
+        lock.unlock();
+        read();
+    }
+
+    // must be called with mMutex held and no write in flight
+    void flush() {
+        mWriting.swap(mQueued);
+        mWriteBuffers.clear();
+        for (auto& response : mWriting) {
+            mWriteBuffers.push_back(boost::asio::buffer(response->data(), response->size()));
+        }
+        ++mPending;
+        boost::asio::async_write(mStream, mWriteBuffers, [this](const error_code& ec, size_t) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            for (auto& response : mWriting) {
+                mPool.push_back(std::move(response));
             }
-            crossbow::serializer ser(mBuffer.get());
-            ser & sizer.size;
-            ser & result;
-            ser.buffer.release();
-            // send the result back
-            boost::asio::async_write(mSocket,
-                    boost::asio::buffer(mBuffer.get(), sizer.size),
-                    [this](const error_code& ec, size_t bytes_written) {
-                        if (ec) {
-                            std::cerr << ec.message() << std::endl;
-                            mSocket.close();
-                            mImpl.close();
-                            return;
-                        }
-                        read(0);
-                    }
-            );
+            mWriting.clear();
+            if (ec) {
+                fail(lock, ec.message());
+                return;
+            }
+            if (!mQueued.empty()) {
+                flush();
+            } else if (doQuit) {
+                mStream.get_io_service().stop();
+            }
+            release(lock);
         });
     }
-    void read(size_t bytes_read = 0) {
-        if (bytes_read == 0 && doQuit) {
-            mSocket.get_io_service().stop();
+
+    // Drops one pending operation, the connection is closed once the last one
+    // is gone after a failure
+    void release(std::unique_lock<std::mutex>& lock) {
+        if (--mPending == 0 && mFailed) {
+            lock.unlock();
+            mImpl.close();
         }
-        size_t reqSize = 0;
-        if (bytes_read != 0) {
-            reqSize = *reinterpret_cast<size_t*>(mBuffer.get());
+    }
+
+    void fail(std::unique_lock<std::mutex>& lock, const std::string& reason) {
+        if (!mFailed) {
+            std::cerr << reason << std::endl;
+            mFailed = true;
+            mStream.close();
         }
-        if (bytes_read != 0 && reqSize == bytes_read) {
-            // done reading
-            auto cmd = *reinterpret_cast<Command*>(mBuffer.get() + sizeof(size_t));
-            SWITCH_CASE(Command, cmd, COMMANDS)
+        release(lock);
+    }
+
+    void read() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (doQuit) {
+            // the last response still has to go out before the server stops
+            if (mWriting.empty()) {
+                mStream.get_io_service().stop();
+            }
             return;
-        } else if (bytes_read >= 8 && reqSize > mBufSize) {
-            std::unique_ptr<uint8_t[]> newBuf(new uint8_t[reqSize]);
-            memcpy(newBuf.get(), mBuffer.get(), mBufSize);
-            mBuffer.swap(newBuf);
-            mBufSize = reqSize;
         }
-        mSocket.async_read_some(boost::asio::buffer(mBuffer.get() + bytes_read, mBufSize - bytes_read),
-                [this, bytes_read](const error_code& ec, size_t br){
-                    if (ec) {
-                        std::cerr << ec.message() << std::endl;
-                        mSocket.close();
-                        mImpl.close();
-                        return;
-                    }
-                    read(bytes_read + br);
-                });
+        ++mPending;
+        lock.unlock();
+        mReader.read([this](const error_code& ec, const uint8_t* payload, size_t size) {
+            if (ec || size < sizeof(Command)) {
+                std::unique_lock<std::mutex> lock(mMutex);
+                fail(lock, ec ? ec.message() : "Request without command");
+                return;
+            }
+            // the read turns into the execution of the request, mPending stays
+            mRequest = payload;
+            mRequestSize = size;
+            Command cmd;
+            memcpy(&cmd, payload, sizeof(cmd));
+            SWITCH_CASE(Command, cmd, COMMANDS)
+        });
     }
 };
 
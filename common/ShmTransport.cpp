@@ -0,0 +1,310 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "ShmTransport.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <crossbow/logger.hpp>
+
+using namespace boost::asio;
+using error_code = boost::system::error_code;
+
+namespace tpcc {
+
+constexpr size_t ShmRing::CAPACITY;
+
+size_t ShmRing::write(const void* src, size_t size) {
+    auto h = head.load(std::memory_order_relaxed);
+    auto t = tail.load(std::memory_order_acquire);
+    auto n = std::min<size_t>(size, CAPACITY - (h - t));
+    if (n == 0) return 0;
+    auto pos = h % CAPACITY;
+    auto first = std::min(n, CAPACITY - pos);
+    memcpy(data + pos, src, first);
+    memcpy(data, reinterpret_cast<const uint8_t*>(src) + first, n - first);
+    head.store(h + n, std::memory_order_release);
+    return n;
+}
+
+size_t ShmRing::read(void* dest, size_t size) {
+    auto t = tail.load(std::memory_order_relaxed);
+    auto h = head.load(std::memory_order_acquire);
+    auto n = std::min<size_t>(size, h - t);
+    if (n == 0) return 0;
+    auto pos = t % CAPACITY;
+    auto first = std::min(n, CAPACITY - pos);
+    memcpy(dest, data + pos, first);
+    memcpy(reinterpret_cast<uint8_t*>(dest) + first, data, n - first);
+    tail.store(t + n, std::memory_order_release);
+    return n;
+}
+
+namespace impl {
+
+constexpr uint64_t SEGMENT_MAGIC = 0x314d485343435054; // "TPCCSHM1"
+
+struct ShmSegment {
+    uint64_t magic;
+    ShmRing toServer;
+    ShmRing toClient;
+};
+
+// Everything a connection needs, shared with the pending polls so they can
+// still run after the transport has been destroyed
+struct ShmState {
+    io_service& service;
+    local::stream_protocol::socket control;
+    ShmSegment* segment = nullptr;
+    ShmRing* in = nullptr;
+    ShmRing* out = nullptr;
+    std::atomic<bool> closed;
+    // set once the control socket is closed by the peer
+    std::atomic<bool> peerGone;
+    uint8_t controlByte = 0;
+    std::string name;
+
+    ShmState(io_service& service, local::stream_protocol::socket&& control)
+        : service(service)
+        , control(std::move(control))
+        , closed(false)
+        , peerGone(false)
+    {}
+
+    ~ShmState() {
+        if (segment) {
+            munmap(segment, sizeof(ShmSegment));
+        }
+    }
+
+    // the peer never writes to the control socket, so this read only
+    // completes when the peer goes away
+    static void watchPeer(const std::shared_ptr<ShmState>& self) {
+        self->control.async_read_some(buffer(&self->controlByte, 1), [self](const error_code&, size_t) {
+            self->peerGone = true;
+        });
+    }
+};
+
+} // namespace impl
+
+namespace {
+
+using impl::ShmState;
+
+boost::system::system_error lastError() {
+    return boost::system::system_error(error_code(errno, boost::system::system_category()));
+}
+
+// A read or write that polls its ring until it can make progress
+struct PendingOp {
+    std::shared_ptr<ShmState> state;
+    uint8_t* data;
+    size_t size;
+    Transport::Handler handler;
+    unsigned spins;
+};
+
+// Spinning is only cheap while the peer runs on another core, so every now
+// and then the thread is given up in case client and server share one
+constexpr unsigned SPINS_BEFORE_YIELD = 64;
+
+void repost(std::shared_ptr<PendingOp> op, void (*poll)(std::shared_ptr<PendingOp>)) {
+    if (++op->spins % SPINS_BEFORE_YIELD == 0) {
+        std::this_thread::yield();
+    }
+    op->state->service.post([op, poll]() { poll(op); });
+}
+
+void pollRead(std::shared_ptr<PendingOp> op) {
+    auto& state = *op->state;
+    if (state.closed) {
+        op->handler(error::operation_aborted, 0);
+        return;
+    }
+    // check for the end before reading, the peer writes everything before it
+    // closes its ring
+    bool end = state.in->closed.load(std::memory_order_acquire) || state.peerGone;
+    auto n = state.in->read(op->data, op->size);
+    if (n > 0 || op->size == 0) {
+        op->handler(error_code(), n);
+    } else if (end) {
+        op->handler(error::eof, 0);
+    } else {
+        repost(op, &pollRead);
+    }
+}
+
+void pollWrite(std::shared_ptr<PendingOp> op) {
+    auto& state = *op->state;
+    if (state.closed) {
+        op->handler(error::operation_aborted, 0);
+        return;
+    }
+    if (state.in->closed.load(std::memory_order_acquire) || state.peerGone) {
+        op->handler(error::broken_pipe, 0);
+        return;
+    }
+    auto n = state.out->write(op->data, op->size);
+    if (n > 0 || op->size == 0) {
+        op->handler(error_code(), n);
+    } else {
+        repost(op, &pollWrite);
+    }
+}
+
+void mapSegment(ShmState& state, int fd) {
+    void* addr = mmap(nullptr, sizeof(impl::ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        throw lastError();
+    }
+    state.segment = reinterpret_cast<impl::ShmSegment*>(addr);
+}
+
+std::atomic<unsigned> segmentCounter(0);
+
+} // anonymous namespace
+
+ShmTransport::ShmTransport(std::shared_ptr<impl::ShmState> state)
+    : mState(std::move(state))
+{}
+
+ShmTransport::~ShmTransport() {
+    close();
+}
+
+void ShmTransport::readSome(void* data, size_t size, Handler handler) {
+    std::shared_ptr<PendingOp> op(new PendingOp{mState, reinterpret_cast<uint8_t*>(data), size, std::move(handler), 0});
+    mState->service.post([op]() { pollRead(op); });
+}
+
+void ShmTransport::writeSome(const void* data, size_t size, Handler handler) {
+    std::shared_ptr<PendingOp> op(new PendingOp{mState, reinterpret_cast<uint8_t*>(const_cast<void*>(data)), size,
+            std::move(handler), 0});
+    mState->service.post([op]() { pollWrite(op); });
+}
+
+void ShmTransport::close() {
+    if (mState->closed.exchange(true)) return;
+    mState->out->closed.store(true, std::memory_order_release);
+    error_code ec;
+    mState->control.close(ec);
+}
+
+std::unique_ptr<Transport> ShmTransport::connect(io_service& service, const std::string& path) {
+    local::stream_protocol::socket control(service);
+    control.connect(local::stream_protocol::endpoint(path));
+    std::shared_ptr<ShmState> state(new ShmState(service, std::move(control)));
+    state->name = "/tpcc-" + std::to_string(getpid()) + "-" + std::to_string(segmentCounter++);
+    int fd = shm_open(state->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw lastError();
+    }
+    try {
+        if (ftruncate(fd, sizeof(impl::ShmSegment)) != 0) {
+            throw lastError();
+        }
+        mapSegment(*state, fd);
+    } catch (...) {
+        ::close(fd);
+        shm_unlink(state->name.c_str());
+        throw;
+    }
+    ::close(fd);
+    new (state->segment) impl::ShmSegment();
+    state->segment->magic = impl::SEGMENT_MAGIC;
+    state->in = &state->segment->toClient;
+    state->out = &state->segment->toServer;
+
+    // [uint8_t length][name], answered with one byte once the server has it mapped
+    std::string hello(1, char(state->name.size()));
+    hello += state->name;
+    error_code ec;
+    write(state->control, buffer(hello), ec);
+    uint8_t ack = 0;
+    if (!ec) {
+        read(state->control, buffer(&ack, 1), ec);
+    }
+    shm_unlink(state->name.c_str());
+    if (ec) {
+        throw boost::system::system_error(ec);
+    }
+    ShmState::watchPeer(state);
+    return std::unique_ptr<Transport>(new ShmTransport(state));
+}
+
+void ShmTransport::accept(io_service& service, local::stream_protocol::socket socket,
+        std::function<void(std::unique_ptr<Transport>)> handler) {
+    std::shared_ptr<ShmState> state(new ShmState(service, std::move(socket)));
+    async_read(state->control, buffer(&state->controlByte, 1), [state, handler](const error_code& ec, size_t) {
+        if (ec || state->controlByte == 0) {
+            LOG_ERROR("Shared memory handshake failed: %1%", ec ? ec.message() : "empty segment name");
+            return;
+        }
+        state->name.resize(state->controlByte);
+        async_read(state->control, buffer(&state->name[0], state->name.size()),
+                [state, handler](const error_code& ec, size_t) {
+            if (ec) {
+                LOG_ERROR("Shared memory handshake failed: %1%", ec.message());
+                return;
+            }
+            int fd = shm_open(state->name.c_str(), O_RDWR, 0600);
+            if (fd < 0) {
+                LOG_ERROR("Could not open shared memory segment %1%: %2%", state->name, strerror(errno));
+                return;
+            }
+            struct stat st;
+            bool sizeOk = fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(impl::ShmSegment);
+            try {
+                if (sizeOk) mapSegment(*state, fd);
+            } catch (boost::system::system_error& e) {
+                LOG_ERROR("Could not map shared memory segment %1%: %2%", state->name, e.what());
+            }
+            ::close(fd);
+            if (!state->segment || state->segment->magic != impl::SEGMENT_MAGIC) {
+                LOG_ERROR("Invalid shared memory segment %1%", state->name);
+                return;
+            }
+            state->in = &state->segment->toServer;
+            state->out = &state->segment->toClient;
+            state->controlByte = 1;
+            async_write(state->control, buffer(&state->controlByte, 1), [state, handler](const error_code& ec, size_t) {
+                if (ec) {
+                    LOG_ERROR("Shared memory handshake failed: %1%", ec.message());
+                    return;
+                }
+                ShmState::watchPeer(state);
+                handler(std::unique_ptr<Transport>(new ShmTransport(state)));
+            });
+        });
+    });
+}
+
+} // namespace tpcc
@@ -0,0 +1,77 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include "Transport.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace tpcc {
+namespace impl {
+
+struct ShmState;
+
+} // namespace impl
+
+// Single producer, single consumer byte ring that lives in shared memory
+struct ShmRing {
+    static constexpr size_t CAPACITY = 256 * 1024;
+    // total bytes written and read, the ring holds [tail, head)
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    // set by the writer when it goes away
+    alignas(64) std::atomic<bool> closed;
+    uint8_t data[CAPACITY];
+
+    // both copy as many bytes as possible and return how many, 0 if the ring
+    // is full (write) or empty (read)
+    size_t write(const void* src, size_t size);
+    size_t read(void* dest, size_t size);
+};
+
+// Transport through two rings in a shared memory segment. The client creates
+// the segment and sends its name over a Unix domain socket, which stays open
+// afterwards so both sides notice when the other one dies. There are no
+// wakeups, a pending read or write polls its ring by reposting itself to the
+// io_service, so a connection burns a core while it waits but does not need
+// a system call per message.
+class ShmTransport : public Transport {
+    std::shared_ptr<impl::ShmState> mState;
+
+    explicit ShmTransport(std::shared_ptr<impl::ShmState> state);
+public:
+    ~ShmTransport();
+    using Transport::writeSome;
+    void readSome(void* data, size_t size, Handler handler) override;
+    void writeSome(const void* data, size_t size, Handler handler) override;
+    void close() override;
+
+    // client side, blocks until the server has mapped the segment
+    static std::unique_ptr<Transport> connect(boost::asio::io_service& service, const std::string& path);
+    // server side, maps the segment announced on a freshly accepted socket and
+    // passes the new transport to handler, failed handshakes are only logged
+    static void accept(boost::asio::io_service& service, boost::asio::local::stream_protocol::socket socket,
+            std::function<void(std::unique_ptr<Transport>)> handler);
+};
+
+} // namespace tpcc
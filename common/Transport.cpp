@@ -0,0 +1,195 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "Transport.hpp"
+#include "ShmTransport.hpp"
+#ifdef TPCC_USE_IO_URING
+#include "UringTransport.hpp"
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+#include <crossbow/logger.hpp>
+
+using namespace boost::asio;
+using error_code = boost::system::error_code;
+
+namespace tpcc {
+
+namespace {
+
+const std::string UNIX_PREFIX = "unix:";
+const std::string SHM_PREFIX = "shm:";
+
+bool hasPrefix(const std::string& str, const std::string& prefix) {
+    return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+} // anonymous namespace
+
+std::unique_ptr<Transport> connectTransport(io_service& service, const std::string& host, const std::string& port) {
+    if (hasPrefix(host, SHM_PREFIX)) {
+        return ShmTransport::connect(service, host.substr(SHM_PREFIX.size()));
+    }
+    if (hasPrefix(host, UNIX_PREFIX)) {
+        std::unique_ptr<UnixTransport> transport(new UnixTransport(service));
+        transport->socket().connect(local::stream_protocol::endpoint(host.substr(UNIX_PREFIX.size())));
+        return std::move(transport);
+    }
+    ip::tcp::resolver resolver(service);
+    ip::tcp::resolver::iterator iter;
+    if (host == "") {
+        iter = resolver.resolve(ip::tcp::resolver::query(port));
+    } else {
+        iter = resolver.resolve(ip::tcp::resolver::query(host, port));
+    }
+    std::unique_ptr<TcpTransport> transport(new TcpTransport(service));
+    boost::asio::connect(transport->socket(), iter);
+    return std::move(transport);
+}
+
+Listener::Listener(io_service& service, const std::string& host, const std::string& port)
+    : mService(service)
+    , mTcp(service)
+    , mUnix(service)
+{
+    mShm = hasPrefix(host, SHM_PREFIX);
+    if (mShm || hasPrefix(host, UNIX_PREFIX)) {
+        mPath = host.substr(mShm ? SHM_PREFIX.size() : UNIX_PREFIX.size());
+        // a socket file left over from an earlier run would make bind fail
+        ::unlink(mPath.c_str());
+        error_code err;
+        local::stream_protocol::endpoint endpoint(mPath);
+        mUnix.open(endpoint.protocol());
+        mUnix.bind(endpoint, err);
+        if (err) {
+            throw std::runtime_error("Could not bind to " + mPath + ": " + err.message());
+        }
+        mUnix.listen();
+        return;
+    }
+    ip::tcp::acceptor::reuse_address option(true);
+    ip::tcp::resolver resolver(service);
+    ip::tcp::resolver::iterator iter;
+    if (host == "") {
+        iter = resolver.resolve(ip::tcp::resolver::query(port));
+    } else {
+        iter = resolver.resolve(ip::tcp::resolver::query(host, port));
+    }
+    ip::tcp::resolver::iterator end;
+    for (; iter != end; ++iter) {
+        error_code err;
+        auto endpoint = iter->endpoint();
+        auto protocol = iter->endpoint().protocol();
+        mTcp.open(protocol);
+        mTcp.set_option(option);
+        mTcp.bind(endpoint, err);
+        if (err) {
+            mTcp.close();
+            LOG_WARN("Bind attempt failed " + err.message());
+            continue;
+        }
+        break;
+    }
+    if (!mTcp.is_open()) {
+        throw std::runtime_error("Could not bind");
+    }
+    mTcp.listen();
+}
+
+Listener::~Listener() {
+    if (!mPath.empty()) {
+        ::unlink(mPath.c_str());
+    }
+}
+
+bool Listener::enableIoUring() {
+    if (mShm) return false;
+#ifdef TPCC_USE_IO_URING
+    mUring = UringBackend::create(mService);
+#endif
+    return mUring != nullptr;
+}
+
+template<class Protocol>
+std::unique_ptr<Transport> Listener::wrap(typename Protocol::socket& socket) {
+#ifdef TPCC_USE_IO_URING
+    if (mUring) {
+        // the backend needs its own fd, the Asio socket still owns this one
+        int fd = ::dup(socket.native_handle());
+        error_code ec;
+        socket.close(ec);
+        if (fd >= 0) {
+            return mUring->adopt(fd);
+        }
+        LOG_ERROR("Could not hand connection to io_uring: %1%", strerror(errno));
+        return nullptr;
+    }
+#endif
+    return std::unique_ptr<Transport>(new SocketTransport<Protocol>(std::move(socket)));
+}
+
+void Listener::accept(Handler handler) {
+    if (mUnix.is_open()) {
+        acceptUnix(std::move(handler));
+    } else {
+        acceptTcp(std::move(handler));
+    }
+}
+
+void Listener::acceptTcp(Handler handler) {
+    auto socket = new ip::tcp::socket(mService);
+    mTcp.async_accept(*socket, [this, socket, handler](const error_code& err) {
+        std::unique_ptr<ip::tcp::socket> s(socket);
+        if (err) {
+            LOG_ERROR(err.message());
+            return;
+        }
+        auto transport = wrap<ip::tcp>(*s);
+        if (transport) {
+            handler(std::move(transport));
+        }
+        acceptTcp(handler);
+    });
+}
+
+void Listener::acceptUnix(Handler handler) {
+    auto socket = new local::stream_protocol::socket(mService);
+    mUnix.async_accept(*socket, [this, socket, handler](const error_code& err) {
+        std::unique_ptr<local::stream_protocol::socket> s(socket);
+        if (err) {
+            LOG_ERROR(err.message());
+            return;
+        }
+        if (mShm) {
+            ShmTransport::accept(mService, std::move(*s), handler);
+        } else if (auto transport = wrap<local::stream_protocol>(*s)) {
+            handler(std::move(transport));
+        }
+        acceptUnix(handler);
+    });
+}
+
+} // namespace tpcc
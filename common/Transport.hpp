@@ -0,0 +1,224 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/version.hpp>
+#include <boost/asio.hpp>
+
+namespace tpcc {
+
+// A bidirectional byte stream between a client and the server. Which one is
+// used is decided by the address at runtime: "unix:<path>" is a Unix domain
+// socket, "shm:<path>" a pair of shared memory rings that is set up over the
+// Unix domain socket at <path>, anything else is a TCP host.
+class Transport {
+public:
+    using Handler = std::function<void(const boost::system::error_code&, size_t)>;
+    virtual ~Transport() = default;
+    // Start reading or writing at least one byte, the same contract as
+    // async_read_some and async_write_some on an Asio socket
+    virtual void readSome(void* data, size_t size, Handler handler) = 0;
+    virtual void writeSome(const void* data, size_t size, Handler handler) = 0;
+    // Gathering write of up to count buffers. Transports that pay a system
+    // call per write override this, the default only writes the first buffer.
+    virtual void writeSome(const boost::asio::const_buffer* buffers, size_t count, Handler handler) {
+        writeSome(boost::asio::buffer_cast<const void*>(buffers[0]), boost::asio::buffer_size(buffers[0]),
+                std::move(handler));
+    }
+    virtual void close() = 0;
+};
+
+// Transport over an Asio stream socket (TCP or Unix domain socket)
+template<class Protocol>
+class SocketTransport : public Transport {
+    typename Protocol::socket mSocket;
+public:
+    explicit SocketTransport(boost::asio::io_service& service)
+        : mSocket(service)
+    {}
+    explicit SocketTransport(typename Protocol::socket&& socket)
+        : mSocket(std::move(socket))
+    {}
+    typename Protocol::socket& socket() { return mSocket; }
+    void readSome(void* data, size_t size, Handler handler) override {
+        mSocket.async_read_some(boost::asio::buffer(data, size), std::move(handler));
+    }
+    void writeSome(const void* data, size_t size, Handler handler) override {
+        mSocket.async_write_some(boost::asio::buffer(data, size), std::move(handler));
+    }
+    void writeSome(const boost::asio::const_buffer* buffers, size_t count, Handler handler) override {
+        mSocket.async_write_some(std::vector<boost::asio::const_buffer>(buffers, buffers + count),
+                std::move(handler));
+    }
+    void close() override {
+        boost::system::error_code ec;
+        mSocket.shutdown(Protocol::socket::shutdown_both, ec);
+        mSocket.close(ec);
+    }
+};
+
+using TcpTransport = SocketTransport<boost::asio::ip::tcp>;
+using UnixTransport = SocketTransport<boost::asio::local::stream_protocol>;
+
+namespace impl {
+
+#if BOOST_VERSION >= 106600
+template<class Buffer, class Sequence>
+Buffer firstBuffer(const Sequence& buffers) {
+    auto end = boost::asio::buffer_sequence_end(buffers);
+    for (auto i = boost::asio::buffer_sequence_begin(buffers); i != end; ++i) {
+        Buffer b(*i);
+        if (boost::asio::buffer_size(b) > 0) return b;
+    }
+    return Buffer();
+}
+#else
+template<class Buffer, class Sequence>
+Buffer firstBuffer(const Sequence& buffers) {
+    for (auto i = buffers.begin(); i != buffers.end(); ++i) {
+        Buffer b(*i);
+        if (boost::asio::buffer_size(b) > 0) return b;
+    }
+    return Buffer();
+}
+#endif
+
+// Collects the non-empty buffers of a sequence into out, at most max of them,
+// and returns how many there are
+#if BOOST_VERSION >= 106600
+template<class Sequence>
+size_t gatherBuffers(const Sequence& buffers, boost::asio::const_buffer* out, size_t max) {
+    size_t count = 0;
+    auto end = boost::asio::buffer_sequence_end(buffers);
+    for (auto i = boost::asio::buffer_sequence_begin(buffers); i != end && count < max; ++i) {
+        boost::asio::const_buffer b(*i);
+        if (boost::asio::buffer_size(b) > 0) out[count++] = b;
+    }
+    return count;
+}
+#else
+template<class Sequence>
+size_t gatherBuffers(const Sequence& buffers, boost::asio::const_buffer* out, size_t max) {
+    size_t count = 0;
+    for (auto i = buffers.begin(); i != buffers.end() && count < max; ++i) {
+        boost::asio::const_buffer b(*i);
+        if (boost::asio::buffer_size(b) > 0) out[count++] = b;
+    }
+    return count;
+}
+#endif
+
+} // namespace impl
+
+// Holds the Transport of a connection and makes it look like an Asio stream,
+// so async_read, async_write and FrameReader work on every transport. Reads
+// only hand the first non-empty buffer to the transport, writes up to
+// MAX_GATHER of them; the *_some semantics allow that and the composed
+// operations call again for the rest.
+class TransportStream {
+    static constexpr size_t MAX_GATHER = 16;
+
+    boost::asio::io_service& mService;
+    std::unique_ptr<Transport> mTransport;
+public:
+    explicit TransportStream(boost::asio::io_service& service)
+        : mService(service)
+    {}
+    void reset(std::unique_ptr<Transport> transport) {
+        mTransport = std::move(transport);
+    }
+    boost::asio::io_service& get_io_service() {
+        return mService;
+    }
+#if BOOST_VERSION >= 106600
+    using executor_type = boost::asio::io_context::executor_type;
+    executor_type get_executor() {
+        return mService.get_executor();
+    }
+#endif
+    template<class MutableBufferSequence, class Handler>
+    void async_read_some(const MutableBufferSequence& buffers, Handler&& handler) {
+        auto b = impl::firstBuffer<boost::asio::mutable_buffer>(buffers);
+        mTransport->readSome(boost::asio::buffer_cast<void*>(b), boost::asio::buffer_size(b),
+                std::forward<Handler>(handler));
+    }
+    template<class ConstBufferSequence, class Handler>
+    void async_write_some(const ConstBufferSequence& buffers, Handler&& handler) {
+        boost::asio::const_buffer b[MAX_GATHER];
+        size_t count = impl::gatherBuffers(buffers, b, MAX_GATHER);
+        if (count <= 1) {
+            mTransport->writeSome(boost::asio::buffer_cast<const void*>(b[0]), boost::asio::buffer_size(b[0]),
+                    std::forward<Handler>(handler));
+        } else {
+            mTransport->writeSome(b, count, std::forward<Handler>(handler));
+        }
+    }
+    void close() {
+        if (mTransport) mTransport->close();
+    }
+};
+
+// Opens a connection to host (see Transport for the address syntax), throws
+// boost::system::system_error if that fails
+std::unique_ptr<Transport> connectTransport(boost::asio::io_service& service, const std::string& host,
+        const std::string& port);
+
+class UringBackend;
+
+// Accepts connections for the server on a TCP port, a Unix domain socket or
+// shared memory, depending on the host it is bound to
+class Listener {
+public:
+    using Handler = std::function<void(std::unique_ptr<Transport>)>;
+private:
+    boost::asio::io_service& mService;
+    boost::asio::ip::tcp::acceptor mTcp;
+    boost::asio::local::stream_protocol::acceptor mUnix;
+    std::string mPath;
+    bool mShm = false;
+    std::shared_ptr<UringBackend> mUring;
+public:
+    // throws std::runtime_error if it can not bind
+    Listener(boost::asio::io_service& service, const std::string& host, const std::string& port);
+    ~Listener();
+    // Hands accepted sockets to an io_uring backend instead of the Asio
+    // reactor. Returns false if tpcc was built without USE_IO_URING or the
+    // kernel lacks support, the Asio path is used then. Connections must not
+    // outlive the listener once this is enabled.
+    bool enableIoUring();
+    // calls handler with every new connection until accepting fails
+    void accept(Handler handler);
+private:
+    void acceptTcp(Handler handler);
+    void acceptUnix(Handler handler);
+    template<class Protocol>
+    std::unique_ptr<Transport> wrap(typename Protocol::socket& socket);
+};
+
+} // namespace tpcc
@@ -0,0 +1,525 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "UringTransport.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <crossbow/logger.hpp>
+
+using namespace boost::asio;
+using error_code = boost::system::error_code;
+
+namespace tpcc {
+
+namespace {
+
+constexpr unsigned QUEUE_DEPTH = 1024;
+// every connection can have several receive completions in flight
+constexpr unsigned COMPLETION_QUEUE_DEPTH = 16 * QUEUE_DEPTH;
+// number of receive buffers, has to be a power of two
+constexpr unsigned NUM_BUFFERS = 1024;
+constexpr size_t BUFFER_SIZE = 4096;
+// received bytes nobody read yet, above this the receive is cancelled until
+// read() drained half of them, so a peer that does not wait for responses
+// runs into TCP flow control instead of growing the server's memory
+constexpr size_t MAX_BACKLOG = 64 * BUFFER_SIZE;
+constexpr int BUFFER_GROUP = 0;
+
+// the low bits of the user data tell which operation of a connection completed
+enum class Op : uint64_t {
+    RECEIVE = 0,
+    SEND = 1,
+    CANCEL = 2,
+};
+
+uint64_t userData(uint64_t id, Op op) {
+    return id << 2 | uint64_t(op);
+}
+
+error_code systemError(int err) {
+    return error_code(err, boost::system::system_category());
+}
+
+} // anonymous namespace
+
+struct UringBackend::Ring {
+    io_uring ring;
+    io_uring_buf_ring* buffers = nullptr;
+    std::unique_ptr<uint8_t[]> memory;
+    // buffers handed back since the last advance
+    unsigned recycled = 0;
+
+    uint8_t* buffer(unsigned bid) {
+        return memory.get() + bid * BUFFER_SIZE;
+    }
+    void recycle(unsigned bid) {
+        io_uring_buf_ring_add(buffers, buffer(bid), BUFFER_SIZE, bid, io_uring_buf_ring_mask(NUM_BUFFERS), recycled++);
+    }
+    void commitRecycled() {
+        io_uring_buf_ring_advance(buffers, recycled);
+        recycled = 0;
+    }
+    // nullptr if the submission queue is full and can not be drained
+    io_uring_sqe* sqe() {
+        auto res = io_uring_get_sqe(&ring);
+        if (res == nullptr) {
+            // the submission queue is full, make room
+            io_uring_submit(&ring);
+            res = io_uring_get_sqe(&ring);
+        }
+        return res;
+    }
+    void prepReceive(io_uring_sqe* sqe, int fd, uint64_t data) {
+        io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        io_uring_sqe_set_data64(sqe, data);
+    }
+    int probeReceive();
+};
+
+// Kernels before 6.0 have buffer rings but no multishot receive and fail it
+// with -EINVAL. There is no opcode probe for a flag, so this arms one on a
+// socket pair and waits for the byte sent through it. Returns 0 or -errno.
+// Connection ids start at 1, late completions of the probe are dropped.
+int UringBackend::Ring::probeReceive() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        return -errno;
+    }
+    auto data = userData(0, Op::RECEIVE);
+    prepReceive(io_uring_get_sqe(&ring), fds[0], data);
+    uint8_t byte = 0;
+    int res = ::send(fds[1], &byte, 1, MSG_NOSIGNAL) < 0 ? -errno : 0;
+    if (res == 0) {
+        res = io_uring_submit_and_wait(&ring, 1);
+    }
+    io_uring_cqe* cqe = nullptr;
+    if (res >= 0) {
+        res = io_uring_wait_cqe(&ring, &cqe);
+    }
+    if (res == 0) {
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            recycle(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            commitRecycled();
+        }
+        res = cqe->res < 0 ? cqe->res : 0;
+        bool armed = cqe->flags & IORING_CQE_F_MORE;
+        io_uring_cqe_seen(&ring, cqe);
+        if (armed) {
+            auto sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_cancel64(sqe, data, 0);
+            io_uring_sqe_set_data64(sqe, userData(0, Op::CANCEL));
+            io_uring_submit(&ring);
+        }
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return res;
+}
+
+struct UringBackend::Connection {
+    uint64_t id;
+    int fd;
+    bool closed = false;
+    // a multishot receive is armed, it is disarmed by its last completion
+    bool receiving = false;
+    // the receive was cancelled because the backlog is full
+    bool paused = false;
+    // set when the receive ended for good, reported once the backlog is read
+    error_code error;
+    // received bytes nobody asked for yet are [backlogBegin, backlog.size())
+    std::vector<uint8_t> backlog;
+    size_t backlogBegin = 0;
+    uint8_t* readData = nullptr;
+    size_t readSize = 0;
+    Transport::Handler readHandler;
+    Transport::Handler writeHandler;
+    // the gathered buffers of the send in flight
+    std::vector<iovec> iov;
+    msghdr msg;
+
+    Connection(uint64_t id, int fd)
+        : id(id)
+        , fd(fd)
+    {}
+};
+
+namespace {
+
+class UringTransport : public Transport {
+    UringBackend& mBackend;
+    std::shared_ptr<UringBackend::Connection> mConnection;
+public:
+    UringTransport(UringBackend& backend, std::shared_ptr<UringBackend::Connection> connection)
+        : mBackend(backend)
+        , mConnection(std::move(connection))
+    {}
+    ~UringTransport() {
+        close();
+    }
+    void readSome(void* data, size_t size, Handler handler) override {
+        mBackend.read(mConnection, data, size, std::move(handler));
+    }
+    void writeSome(const void* data, size_t size, Handler handler) override {
+        mBackend.write(mConnection, data, size, std::move(handler));
+    }
+    void writeSome(const boost::asio::const_buffer* buffers, size_t count, Handler handler) override {
+        mBackend.write(mConnection, buffers, count, std::move(handler));
+    }
+    void close() override {
+        mBackend.close(mConnection);
+    }
+};
+
+} // anonymous namespace
+
+std::unique_ptr<UringBackend> UringBackend::create(io_service& service) {
+    try {
+        return std::unique_ptr<UringBackend>(new UringBackend(service));
+    } catch (boost::system::system_error& e) {
+        LOG_WARN("Could not set up io_uring: %1%", e.what());
+        return nullptr;
+    }
+}
+
+UringBackend::UringBackend(io_service& service)
+    : mService(service)
+    , mRing(new Ring())
+    , mEventFd(service)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = COMPLETION_QUEUE_DEPTH;
+    auto res = io_uring_queue_init_params(QUEUE_DEPTH, &mRing->ring, &params);
+    if (res < 0) {
+        mRing.reset();
+        throw boost::system::system_error(systemError(-res), "io_uring_queue_init_params");
+    }
+    mRing->buffers = io_uring_setup_buf_ring(&mRing->ring, NUM_BUFFERS, BUFFER_GROUP, 0, &res);
+    if (mRing->buffers == nullptr) {
+        io_uring_queue_exit(&mRing->ring);
+        mRing.reset();
+        throw boost::system::system_error(systemError(-res), "io_uring_setup_buf_ring");
+    }
+    mRing->memory.reset(new uint8_t[NUM_BUFFERS * BUFFER_SIZE]);
+    for (unsigned bid = 0; bid < NUM_BUFFERS; ++bid) {
+        mRing->recycle(bid);
+    }
+    mRing->commitRecycled();
+    res = mRing->probeReceive();
+    if (res < 0) {
+        io_uring_free_buf_ring(&mRing->ring, mRing->buffers, NUM_BUFFERS, BUFFER_GROUP);
+        io_uring_queue_exit(&mRing->ring);
+        mRing.reset();
+        throw boost::system::system_error(systemError(-res), "multishot receive");
+    }
+    int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (efd < 0 || io_uring_register_eventfd(&mRing->ring, efd) < 0) {
+        auto err = errno;
+        if (efd >= 0) ::close(efd);
+        io_uring_free_buf_ring(&mRing->ring, mRing->buffers, NUM_BUFFERS, BUFFER_GROUP);
+        io_uring_queue_exit(&mRing->ring);
+        mRing.reset();
+        throw boost::system::system_error(systemError(err), "io_uring_register_eventfd");
+    }
+    mEventFd.assign(efd);
+    waitForCompletions();
+}
+
+UringBackend::~UringBackend() {
+    error_code ec;
+    mEventFd.close(ec);
+    for (auto& c : mConnections) {
+        ::close(c.second->fd);
+    }
+    io_uring_free_buf_ring(&mRing->ring, mRing->buffers, NUM_BUFFERS, BUFFER_GROUP);
+    io_uring_queue_exit(&mRing->ring);
+}
+
+std::unique_ptr<Transport> UringBackend::adopt(int fd) {
+    std::shared_ptr<Connection> conn;
+    {
+        std::lock_guard<std::mutex> _(mMutex);
+        conn = std::make_shared<Connection>(mNextId++, fd);
+        mConnections.emplace(conn->id, conn);
+        if (!armReceive(*conn)) {
+            conn->error = error::no_buffer_space;
+        }
+        scheduleFlush();
+    }
+    return std::unique_ptr<Transport>(new UringTransport(*this, std::move(conn)));
+}
+
+void UringBackend::read(const std::shared_ptr<Connection>& conn, void* data, size_t size, Transport::Handler handler) {
+    std::lock_guard<std::mutex> _(mMutex);
+    if (conn->closed) {
+        post(std::move(handler), error::operation_aborted, 0);
+        return;
+    }
+    auto buffered = conn->backlog.size() - conn->backlogBegin;
+    if (buffered > 0) {
+        auto n = std::min(size, buffered);
+        memcpy(data, conn->backlog.data() + conn->backlogBegin, n);
+        conn->backlogBegin += n;
+        if (conn->backlogBegin == conn->backlog.size()) {
+            conn->backlog.clear();
+            conn->backlogBegin = 0;
+        }
+        if (conn->paused && buffered - n <= MAX_BACKLOG / 2) {
+            conn->paused = false;
+            // the cancelled receive may not have completed yet, then its last
+            // completion arms the new one
+            if (!conn->receiving) {
+                if (armReceive(*conn)) {
+                    scheduleFlush();
+                } else {
+                    conn->error = error::no_buffer_space;
+                }
+            }
+        }
+        post(std::move(handler), error_code(), n);
+    } else if (conn->error) {
+        post(std::move(handler), conn->error, 0);
+    } else {
+        conn->readData = reinterpret_cast<uint8_t*>(data);
+        conn->readSize = size;
+        conn->readHandler = std::move(handler);
+    }
+}
+
+void UringBackend::write(const std::shared_ptr<Connection>& conn, const void* data, size_t size,
+        Transport::Handler handler) {
+    std::lock_guard<std::mutex> _(mMutex);
+    if (conn->closed) {
+        post(std::move(handler), error::operation_aborted, 0);
+        return;
+    }
+    auto sqe = mRing->sqe();
+    if (sqe == nullptr) {
+        post(std::move(handler), error::no_buffer_space, 0);
+        return;
+    }
+    conn->writeHandler = std::move(handler);
+    io_uring_prep_send(sqe, conn->fd, data, size, MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, userData(conn->id, Op::SEND));
+    scheduleFlush();
+}
+
+void UringBackend::write(const std::shared_ptr<Connection>& conn, const boost::asio::const_buffer* buffers,
+        size_t count, Transport::Handler handler) {
+    std::lock_guard<std::mutex> _(mMutex);
+    if (conn->closed) {
+        post(std::move(handler), error::operation_aborted, 0);
+        return;
+    }
+    auto sqe = mRing->sqe();
+    if (sqe == nullptr) {
+        post(std::move(handler), error::no_buffer_space, 0);
+        return;
+    }
+    conn->writeHandler = std::move(handler);
+    conn->iov.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        conn->iov[i].iov_base = const_cast<void*>(boost::asio::buffer_cast<const void*>(buffers[i]));
+        conn->iov[i].iov_len = boost::asio::buffer_size(buffers[i]);
+    }
+    memset(&conn->msg, 0, sizeof(conn->msg));
+    conn->msg.msg_iov = conn->iov.data();
+    conn->msg.msg_iovlen = count;
+    io_uring_prep_sendmsg(sqe, conn->fd, &conn->msg, MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, userData(conn->id, Op::SEND));
+    scheduleFlush();
+}
+
+void UringBackend::close(const std::shared_ptr<Connection>& conn) {
+    std::lock_guard<std::mutex> _(mMutex);
+    if (conn->closed) return;
+    conn->closed = true;
+    if (conn->readHandler) {
+        post(std::move(conn->readHandler), error::operation_aborted, 0);
+        conn->readHandler = nullptr;
+    }
+    // a send in flight still uses the caller's buffers, its handler runs
+    // when the kernel is done with them and the connection goes away then
+    if (!conn->writeHandler) {
+        mConnections.erase(conn->id);
+    }
+    // receive completions of a closed connection are dropped, without a
+    // cancel the shutdown below still ends the receive
+    auto sqe = mRing->sqe();
+    if (sqe != nullptr) {
+        io_uring_prep_cancel64(sqe, userData(conn->id, Op::RECEIVE), 0);
+        io_uring_sqe_set_data64(sqe, userData(conn->id, Op::CANCEL));
+    }
+    // queued entries name the fd by number, the kernel has to take its own
+    // reference before the number can be reused by the next accepted socket
+    io_uring_submit(&mRing->ring);
+    ::shutdown(conn->fd, SHUT_RDWR);
+    ::close(conn->fd);
+}
+
+bool UringBackend::armReceive(Connection& conn) {
+    auto sqe = mRing->sqe();
+    if (sqe == nullptr) return false;
+    mRing->prepReceive(sqe, conn.fd, userData(conn.id, Op::RECEIVE));
+    conn.receiving = true;
+    return true;
+}
+
+void UringBackend::scheduleFlush() {
+    if (mFlushScheduled) return;
+    mFlushScheduled = true;
+    // everything queued until this handler runs goes out with one system call
+    mService.post([this]() {
+        std::lock_guard<std::mutex> _(mMutex);
+        mFlushScheduled = false;
+        io_uring_submit(&mRing->ring);
+    });
+}
+
+void UringBackend::waitForCompletions() {
+    mEventFd.async_read_some(buffer(&mEventCount, sizeof(mEventCount)), [this](const error_code& ec, size_t) {
+        if (ec == error::operation_aborted) return;
+        if (ec && ec != error::would_block) {
+            LOG_ERROR("io_uring eventfd failed: %1%", ec.message());
+            return;
+        }
+        reap();
+        waitForCompletions();
+    });
+}
+
+void UringBackend::reap() {
+    std::vector<Completion> done;
+    {
+        std::lock_guard<std::mutex> _(mMutex);
+        unsigned head;
+        unsigned count = 0;
+        io_uring_cqe* cqe;
+        io_uring_for_each_cqe(&mRing->ring, head, cqe) {
+            ++count;
+            auto data = io_uring_cqe_get_data64(cqe);
+            auto id = data >> 2;
+            switch (Op(data & 3)) {
+            case Op::RECEIVE:
+                onReceive(id, cqe->res, cqe->flags, done);
+                break;
+            case Op::SEND: {
+                auto i = mConnections.find(id);
+                if (i == mConnections.end() || !i->second->writeHandler) break;
+                auto& conn = *i->second;
+                Completion c{std::move(conn.writeHandler), error_code(), 0};
+                conn.writeHandler = nullptr;
+                if (conn.closed) {
+                    c.ec = error::operation_aborted;
+                    mConnections.erase(i);
+                } else if (cqe->res < 0) {
+                    c.ec = systemError(-cqe->res);
+                } else {
+                    c.bytes = size_t(cqe->res);
+                }
+                done.emplace_back(std::move(c));
+                break;
+            }
+            case Op::CANCEL:
+                break;
+            }
+        }
+        io_uring_cq_advance(&mRing->ring, count);
+        mRing->commitRecycled();
+        if (io_uring_sq_ready(&mRing->ring) > 0) {
+            scheduleFlush();
+        }
+    }
+    for (auto& c : done) {
+        c.handler(c.ec, c.bytes);
+    }
+}
+
+void UringBackend::onReceive(uint64_t id, int res, unsigned flags, std::vector<Completion>& done) {
+    const uint8_t* data = nullptr;
+    if (flags & IORING_CQE_F_BUFFER) {
+        auto bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        data = mRing->buffer(bid);
+        // the data is copied out below, so the buffer can go back right away
+        mRing->recycle(bid);
+    }
+    auto i = mConnections.find(id);
+    if (i == mConnections.end() || i->second->closed) return;
+    auto& conn = *i->second;
+    if (res > 0 && data) {
+        deliver(conn, data, size_t(res), done);
+    } else if (res == 0) {
+        conn.error = error::eof;
+    } else if (res != -ENOBUFS && res != -ECANCELED) {
+        conn.error = systemError(-res);
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+        // the kernel ends the multishot receive e.g. when it ran out of
+        // buffers, a paused one is armed again by read()
+        conn.receiving = false;
+        if (!conn.error && !conn.paused && !armReceive(conn)) {
+            conn.error = error::no_buffer_space;
+        }
+    }
+    if (conn.error && conn.readHandler && conn.backlog.size() == conn.backlogBegin) {
+        done.emplace_back(Completion{std::move(conn.readHandler), conn.error, 0});
+        conn.readHandler = nullptr;
+    }
+}
+
+void UringBackend::deliver(Connection& conn, const uint8_t* data, size_t size, std::vector<Completion>& done) {
+    if (conn.readHandler) {
+        auto n = std::min(size, conn.readSize);
+        memcpy(conn.readData, data, n);
+        done.emplace_back(Completion{std::move(conn.readHandler), error_code(), n});
+        conn.readHandler = nullptr;
+        data += n;
+        size -= n;
+    }
+    conn.backlog.insert(conn.backlog.end(), data, data + size);
+    if (!conn.paused && conn.receiving && conn.backlog.size() - conn.backlogBegin > MAX_BACKLOG) {
+        auto sqe = mRing->sqe();
+        if (sqe == nullptr) return;
+        io_uring_prep_cancel64(sqe, userData(conn.id, Op::RECEIVE), 0);
+        io_uring_sqe_set_data64(sqe, userData(conn.id, Op::CANCEL));
+        conn.paused = true;
+    }
+}
+
+void UringBackend::post(Transport::Handler handler, const error_code& ec, size_t bytes) {
+    mService.post([handler, ec, bytes]() {
+        handler(ec, bytes);
+    });
+}
+
+} // namespace tpcc
@@ -0,0 +1,90 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include "Transport.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace tpcc {
+
+// Runs the sockets of an io_service through one io_uring instead of the Asio
+// reactor. Every connection has a single multishot receive armed that fills
+// buffers from a ring registered with the kernel, so reading a request does
+// not need a submission at all. The receive pauses while too much received
+// data waits to be read. Sends are queued and submitted together once
+// per round of the event loop. Completions are signalled through an eventfd
+// that the io_service waits on, handlers run on the io_service threads.
+class UringBackend {
+public:
+    struct Connection;
+private:
+    struct Ring;
+    struct Completion {
+        Transport::Handler handler;
+        boost::system::error_code ec;
+        size_t bytes;
+    };
+
+    boost::asio::io_service& mService;
+    std::unique_ptr<Ring> mRing;
+    boost::asio::posix::stream_descriptor mEventFd;
+    uint64_t mEventCount = 0;
+    // guards the rings and all connections, the io_service may run on several threads
+    std::mutex mMutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Connection>> mConnections;
+    uint64_t mNextId = 1;
+    bool mFlushScheduled = false;
+
+    explicit UringBackend(boost::asio::io_service& service);
+public:
+    // nullptr if the kernel does not support what the backend needs, e.g.
+    // multishot receive (Linux 6.0), the caller falls back to Asio then
+    static std::unique_ptr<UringBackend> create(boost::asio::io_service& service);
+    ~UringBackend();
+
+    // takes over the connected socket fd
+    std::unique_ptr<Transport> adopt(int fd);
+
+    void read(const std::shared_ptr<Connection>& conn, void* data, size_t size, Transport::Handler handler);
+    void write(const std::shared_ptr<Connection>& conn, const void* data, size_t size, Transport::Handler handler);
+    // gathering send, the memory behind the buffers must stay valid until the
+    // handler ran
+    void write(const std::shared_ptr<Connection>& conn, const boost::asio::const_buffer* buffers, size_t count,
+            Transport::Handler handler);
+    void close(const std::shared_ptr<Connection>& conn);
+private:
+    // false if there was no room in the submission queue
+    bool armReceive(Connection& conn);
+    void scheduleFlush();
+    void waitForCompletions();
+    void reap();
+    void onReceive(uint64_t id, int res, unsigned flags, std::vector<Completion>& done);
+    void deliver(Connection& conn, const uint8_t* data, size_t size, std::vector<Completion>& done);
+    void post(Transport::Handler handler, const boost::system::error_code& ec, size_t bytes);
+};
+
+} // namespace tpcc
@@ -32,6 +32,8 @@ namespace tpcc {
 
 Random_t::Random_t() {}
 
+Random_t::Random_t(RandomDevice::result_type seed) : mRandomDevice(seed) {}
+
 namespace {
 uint32_t powerOf(uint32_t a, uint32_t x) {
     if (x == 0) return 1;
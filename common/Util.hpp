@@ -62,6 +62,7 @@ private:
     RandomDevice mRandomDevice;
 public: // Construction
     Random_t();
+    explicit Random_t(RandomDevice::result_type seed);
 public:
     crossbow::string astring(int x, int y);
     crossbow::string nstring(unsigned x, unsigned y);
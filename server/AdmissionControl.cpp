@@ -0,0 +1,105 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "AdmissionControl.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tpcc {
+
+namespace {
+
+constexpr double INITIAL_LIMIT = 20.0;
+// the window latency may exceed the baseline by this factor before the limit shrinks
+constexpr double TOLERANCE = 1.5;
+// the baseline rises by this factor every window, so it follows a lasting
+// change of the storage latency
+constexpr double BASELINE_DRIFT = 1.002;
+// weight of a new limit against the current one
+constexpr double SMOOTHING = 0.2;
+constexpr size_t MIN_WINDOW = 10;
+
+} // anonymous namespace
+
+AdmissionControl::AdmissionControl(size_t maxLimit, size_t queueCapacity, double shortShare, double longShare)
+    : mLimit(std::min(INITIAL_LIMIT, double(maxLimit)))
+    , mMaxLimit(maxLimit)
+    , mQueueCapacity(queueCapacity)
+    , mShares{{shortShare, longShare}}
+{}
+
+bool AdmissionControl::hasRoom(Priority priority) const {
+    auto p = size_t(priority);
+    auto slots = std::max(size_t(1), size_t(mShares[p] * double(limit())));
+    return mInFlight < limit() && mRunning[p] < slots;
+}
+
+bool AdmissionControl::admit(Priority priority, Task task) {
+    auto p = size_t(priority);
+    if (hasRoom(priority)) {
+        ++mInFlight;
+        ++mRunning[p];
+        task();
+        return true;
+    }
+    if (mQueues[p].size() >= mQueueCapacity) {
+        return false;
+    }
+    mQueues[p].push_back(std::move(task));
+    return true;
+}
+
+void AdmissionControl::done(Priority priority, std::chrono::microseconds latency) {
+    --mInFlight;
+    --mRunning[size_t(priority)];
+    if (priority == Priority::SHORT) {
+        mWindowSum += double(latency.count());
+        if (++mWindowCount >= std::max(MIN_WINDOW, limit())) {
+            update();
+        }
+    }
+    for (auto next : {Priority::SHORT, Priority::LONG}) {
+        auto& queue = mQueues[size_t(next)];
+        while (!queue.empty() && hasRoom(next)) {
+            auto task = std::move(queue.front());
+            queue.pop_front();
+            ++mInFlight;
+            ++mRunning[size_t(next)];
+            task();
+        }
+    }
+}
+
+void AdmissionControl::update() {
+    auto latency = mWindowSum / double(mWindowCount);
+    mWindowSum = 0.0;
+    mWindowCount = 0;
+    if (latency <= 0.0) return;
+    mBaseline = mBaseline == 0.0 ? latency : std::min(BASELINE_DRIFT * mBaseline, latency);
+    auto gradient = std::max(0.5, std::min(1.0, TOLERANCE * mBaseline / latency));
+    auto newLimit = mLimit * gradient + std::sqrt(mLimit);
+    mLimit = (1.0 - SMOOTHING) * mLimit + SMOOTHING * newLimit;
+    mLimit = std::max(1.0, std::min(double(mMaxLimit), mLimit));
+}
+
+} // namespace tpcc
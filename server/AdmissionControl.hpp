@@ -0,0 +1,96 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+
+namespace tpcc {
+
+// Short transactions (NewOrder, Payment, OrderStatus) are admitted before
+// long ones (Delivery, StockLevel), so a bunch of long transactions can not
+// hold all slots
+enum class Priority {
+    SHORT,
+    LONG
+};
+
+// Limits how many transactions run at the same time over all connections of
+// a server. Transactions above the limit wait in a bounded queue, if that is
+// full they are rejected right away, so an overloaded server answers fast
+// instead of piling up fibers.
+//
+// The limit adapts to the transaction latency (a gradient algorithm in the
+// style of Netflix' concurrency-limits). The average latency of a window of
+// completed transactions is compared to a baseline, the lowest window
+// average seen, which slowly rises so it can follow lasting changes. The
+// limit is scaled by 1.5 * baseline / latency, clamped to [0.5, 1], plus a
+// headroom of sqrt(limit). While latency stays near the baseline the limit
+// grows, once queueing in storage makes transactions slower it shrinks.
+// Only short transactions are sampled, their latency is what the limit
+// protects and it does not depend on how many long ones are in the mix.
+//
+// Every priority class has its own queue and may only occupy a share of the
+// limit. Free slots go to queued short transactions first.
+//
+// All member functions have to be called from the thread running the
+// io_service.
+class AdmissionControl {
+public:
+    using Task = std::function<void()>;
+private:
+    double mLimit;
+    size_t mMaxLimit;
+    size_t mQueueCapacity;
+    size_t mInFlight = 0;
+    // per priority class
+    std::array<double, 2> mShares;
+    std::array<size_t, 2> mRunning{{0, 0}};
+    std::array<std::deque<Task>, 2> mQueues;
+    // latencies in microseconds, a window is limit() transactions but at least 10
+    double mBaseline = 0.0;
+    double mWindowSum = 0.0;
+    size_t mWindowCount = 0;
+public:
+    // queueCapacity is per priority class, the shares are the fractions of
+    // the limit short and long transactions may occupy
+    AdmissionControl(size_t maxLimit, size_t queueCapacity, double shortShare, double longShare);
+
+    // Runs task right away if there is room, queues it otherwise. Returns
+    // false if the queue is full, task is not run then.
+    bool admit(Priority priority, Task task);
+    // Has to be called when an admitted transaction finished, may run queued
+    // tasks
+    void done(Priority priority, std::chrono::microseconds latency);
+
+    size_t limit() const {
+        return size_t(mLimit);
+    }
+private:
+    bool hasRoom(Priority priority) const;
+    void update();
+};
+
+} // namespace tpcc
@@ -21,7 +21,9 @@
  *     Lucas Braun <braunl@inf.ethz.ch>
  */
 #include "Connection.hpp"
+#include "AdmissionControl.hpp"
 #include "CreateSchema.hpp"
+#include "DeliveryQueue.hpp"
 #include "Populate.hpp"
 #include "Transactions.hpp"
 
@@ -38,17 +40,29 @@ class CommandImpl {
     tell::db::ClientManager<void>& mClientManager;
     std::unique_ptr<tell::db::TransactionFiber<void>> mFiber;
     Transactions mTransactions;
+    bool mStockLevelScan;
+    DeliveryQueue* mDeliveryQueue;
+    AdmissionControl* mAdmission;
+    // when the running transaction was admitted and its priority class
+    std::chrono::steady_clock::time_point mStart;
+    Priority mPriority = Priority::SHORT;
 public:
     CommandImpl(Connection* connection,
-            boost::asio::ip::tcp::socket& socket,
+            TransportStream& stream,
             boost::asio::io_service& service,
             tell::db::ClientManager<void>& clientManager,
-            int16_t numWarehouses)
+            int16_t numWarehouses,
+            bool stockLevelScan,
+            DeliveryQueue* deliveryQueue,
+            AdmissionControl* admission)
         : mConnection(connection)
-        , mServer(*this, socket)
+        , mServer(*this, stream)
         , mService(service)
         , mClientManager(clientManager)
-        , mTransactions(numWarehouses)
+        , mTransactions(numWarehouses, stockLevelScan)
+        , mStockLevelScan(stockLevelScan)
+        , mDeliveryQueue(deliveryQueue)
+        , mAdmission(admission)
     {}
 
     void run() {
@@ -74,7 +88,7 @@ public:
             bool success;
             crossbow::string msg;
             try {
-                createSchema(tx, ch);
+                createSchema(tx, ch, mStockLevelScan);
                 tx.commit();
                 success = true;
             } catch (std::exception& ex) {
@@ -144,81 +158,126 @@ public:
         mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
     }
 
+    // Starts a TPC-C transaction once admission control lets it run, answers
+    // right away with an overloaded result if it has to be rejected
+    template<class Result, class Callback>
+    void startTransaction(Priority priority, std::function<void(tell::db::Transaction&)> transaction,
+            const Callback& callback, tell::store::TransactionType type = tell::store::TransactionType::READ_WRITE) {
+        auto start = [this, priority, transaction, type]() {
+            mStart = std::chrono::steady_clock::now();
+            mPriority = priority;
+            mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction, type)));
+        };
+        if (!mAdmission) {
+            start();
+            return;
+        }
+        if (!mAdmission->admit(priority, start)) {
+            Result res{};
+            res.success = false;
+            res.overloaded = true;
+            res.error = "Server overloaded";
+            callback(res);
+        }
+    }
+
+    // has to be called from the io_service when a transaction started by
+    // startTransaction finished
+    void finishTransaction() {
+        mFiber->wait();
+        mFiber.reset(nullptr);
+        if (mAdmission) {
+            mAdmission->done(mPriority, std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - mStart));
+        }
+    }
+
     template<Command C, class Callback>
     typename std::enable_if<C == Command::NEW_ORDER, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.newOrderTransaction(tx, args);
+        Deadline deadline(args.deadline_ms);
+        auto transaction = [this, args, deadline, callback](tell::db::Transaction& tx) {
+            typename Signature<C>::result res = mTransactions.newOrderTransaction(tx, args, deadline);
             mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
+                finishTransaction();
                 callback(res);
             });
         };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        startTransaction<typename Signature<C>::result>(Priority::SHORT, transaction, callback);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::PAYMENT, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.payment(tx, args);
+        Deadline deadline(args.deadline_ms);
+        auto transaction = [this, args, deadline, callback](tell::db::Transaction& tx) {
+            typename Signature<C>::result res = mTransactions.payment(tx, args, deadline);
             mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
+                finishTransaction();
                 callback(res);
             });
         };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        startTransaction<typename Signature<C>::result>(Priority::SHORT, transaction, callback);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::ORDER_STATUS, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.orderStatus(tx, args);
+        Deadline deadline(args.deadline_ms);
+        auto transaction = [this, args, deadline, callback](tell::db::Transaction& tx) {
+            typename Signature<C>::result res = mTransactions.orderStatus(tx, args, deadline);
             mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
+                finishTransaction();
                 callback(res);
             });
         };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        startTransaction<typename Signature<C>::result>(Priority::SHORT, transaction, callback);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::DELIVERY, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.delivery(tx, args);
+        // deferred mode: acknowledge right away, if the queue is full we
+        // execute the delivery synchronously
+        if (mDeliveryQueue && mDeliveryQueue->push(args)) {
+            typename Signature<C>::result res;
+            res.success = true;
+            res.low_stock = 0;
+            callback(res);
+            return;
+        }
+        Deadline deadline(args.deadline_ms);
+        auto transaction = [this, args, deadline, callback](tell::db::Transaction& tx) {
+            typename Signature<C>::result res = mTransactions.delivery(tx, args, deadline);
             mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
+                finishTransaction();
                 callback(res);
             });
         };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+        startTransaction<typename Signature<C>::result>(Priority::LONG, transaction, callback);
     }
 
     template<Command C, class Callback>
     typename std::enable_if<C == Command::STOCK_LEVEL, void>::type
     execute(const typename Signature<C>::arguments& args, const Callback& callback) {
-        auto transaction = [this, args, callback](tell::db::Transaction& tx) {
-            typename Signature<C>::result res = mTransactions.stockLevel(tx, args);
+        Deadline deadline(args.deadline_ms);
+        auto transaction = [this, args, deadline, callback](tell::db::Transaction& tx) {
+            typename Signature<C>::result res = mTransactions.stockLevel(tx, args, deadline);
             mService.post([this, res, callback]() {
-                mFiber->wait();
-                mFiber.reset(nullptr);
+                finishTransaction();
                 callback(res);
             });
         };
-        mFiber.reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction,
-                        tell::store::TransactionType::READ_ONLY)));
+        startTransaction<typename Signature<C>::result>(Priority::LONG, transaction, callback,
+                tell::store::TransactionType::READ_ONLY);
     }
 };
 
-Connection::Connection(boost::asio::io_service& service, tell::db::ClientManager<void>& clientManager, int16_t numWarehouses)
-    : mSocket(service)
-    , mImpl(new CommandImpl(this, mSocket, service, clientManager, numWarehouses))
+Connection::Connection(boost::asio::io_service& service, tell::db::ClientManager<void>& clientManager, int16_t numWarehouses,
+        bool stockLevelScan, DeliveryQueue* deliveryQueue, AdmissionControl* admission)
+    : mStream(service)
+    , mImpl(new CommandImpl(this, mStream, service, clientManager, numWarehouses, stockLevelScan, deliveryQueue,
+                admission))
 {}
 
 Connection::~Connection() = default;
@@ -30,15 +30,18 @@
 
 namespace tpcc {
 
+class AdmissionControl;
 class CommandImpl;
+class DeliveryQueue;
 
 class Connection {
-    boost::asio::ip::tcp::socket mSocket;
+    TransportStream mStream;
     std::unique_ptr<CommandImpl> mImpl;
 public:
-    Connection(boost::asio::io_service& service, tell::db::ClientManager<void>& clientManager, int16_t numWarehouses);
+    Connection(boost::asio::io_service& service, tell::db::ClientManager<void>& clientManager, int16_t numWarehouses,
+            bool stockLevelScan, DeliveryQueue* deliveryQueue, AdmissionControl* admission);
     ~Connection();
-    decltype(mSocket)& socket() { return mSocket; }
+    TransportStream& stream() { return mStream; }
     void run();
 };
 
@@ -173,7 +173,7 @@ void createOrder(db::Transaction& transaction) {
     transaction.createTable("order", schema);
 }
 
-void createOrderLine(db::Transaction& transaction) {
+void createOrderLine(db::Transaction& transaction, bool stockLevelScan) {
     // Primary Key: (ol_w_id, ol_d_id, ol_o_id, ol_number)
     //              (2 b    , 1 b    , 4 b    , 1 b      )
     LOG_INFO("Creating order line...");
@@ -190,6 +190,18 @@ void createOrderLine(db::Transaction& transaction) {
     schema.addField(store::FieldType::TEXT, "ol_dist_info", true);
     schema.addField(store::FieldType::HASH128, "__partition_token", true);
 
+    if (stockLevelScan) {
+        // ol_i_id is part of the index key, so StockLevel can read it from a
+        // range scan over the index without fetching the order lines
+        schema.addIndex("order-line-idx",
+                std::make_pair(true, std::vector<tell::store::Schema::id_t>{
+                    schema.idOf("ol_w_id")
+                    , schema.idOf("ol_d_id")
+                    , schema.idOf("ol_o_id")
+                    , schema.idOf("ol_number")
+                    , schema.idOf("ol_i_id")
+                    }));
+    }
     transaction.createTable("order-line", schema);
 }
 
@@ -283,14 +295,34 @@ void createSupplier(db::Transaction& transaction) {
 
 } // anonymouse namespace
 
-void createSchema(tell::db::Transaction& transaction, bool useCH) {
+bool hasOrderLineIndex(db::Transaction& transaction) {
+    try {
+        auto olTable = transaction.openTable("order-line").get();
+        try {
+            transaction.lower_bound(olTable, "order-line-idx", {
+                    db::Field(int16_t(0))
+                    , db::Field(int16_t(0))
+                    , db::Field(int32_t(0))
+                    , db::Field(int16_t(0))
+                    , db::Field(int32_t(0))
+                    });
+        } catch (std::exception&) {
+            return false;
+        }
+    } catch (std::exception&) {
+        // no schema yet, this server creates it with the index
+    }
+    return true;
+}
+
+void createSchema(tell::db::Transaction& transaction, bool useCH, bool stockLevelScan) {
     createWarehouse(transaction);
     createDistrict(transaction);
     createCustomer(transaction, useCH);
     createHistory(transaction);
     createNewOrder(transaction);
     createOrder(transaction);
-    createOrderLine(transaction);
+    createOrderLine(transaction, stockLevelScan);
     createItem(transaction);
     createStock(transaction, useCH);
     if (useCH) {
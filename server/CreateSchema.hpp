@@ -36,7 +36,11 @@ class Transaction;
 
 namespace tpcc {
 
-void createSchema(tell::db::Transaction& transaction, bool useCH);
+void createSchema(tell::db::Transaction& transaction, bool useCH, bool stockLevelScan);
+
+// False if the order-line table exists without the index the StockLevel
+// range scan needs, i.e. the schema was created without --stock-level-scan
+bool hasOrderLineIndex(tell::db::Transaction& transaction);
 
 struct WarehouseKey {
     int16_t w_id;
@@ -27,9 +27,10 @@ using namespace tell::db;
 
 namespace tpcc {
 
-DeliveryResult Transactions::delivery(Transaction& tx, const DeliveryIn& in) {
+DeliveryResult Transactions::delivery(Transaction& tx, const DeliveryIn& in, const Deadline& deadline) {
     DeliveryResult result;
     try {
+        checkDeadline(tx, deadline);
         auto noTableF = tx.openTable("new-order");
         auto oTableF = tx.openTable("order");
         auto olTableF = tx.openTable("order-line");
@@ -39,53 +40,86 @@ DeliveryResult Transactions::delivery(Transaction& tx, const DeliveryIn& in) {
         auto oTable = oTableF.get();
         auto noTable = noTableF.get();
         auto ol_delivery_d = now();
+        // probe the new-order index of all districts first, so that the
+        // dependent reads of all ten districts are in flight at the same time
+        std::vector<NewOrderKey> noKeys;
+        noKeys.reserve(10);
         for (int16_t d_id = 1; d_id <= 10; ++d_id) {
             auto iter = tx.lower_bound(noTable, "new-order-idx", {
                     Field(in.w_id),
                     Field(d_id),
                     Field(int32_t(0))});
-            if (iter.done()) continue;
-            NewOrderKey noKey{iter.value()};
-            if (noKey.w_id != in.w_id || noKey.d_id != d_id) continue;
-            OrderKey oKey{in.w_id, d_id, noKey.o_id};
-            auto newOrderF = tx.get(noTable, noKey.key());
-            auto orderF = tx.get(oTable, oKey.key());
-            auto order = orderF.get();
-            auto nOrder = order;
-
-            auto newOrder = newOrderF.get();
-            tx.remove(noTable, noKey.key(), newOrder);
-            nOrder.at("o_carrier_id") = Field(in.o_carrier_id);
-            tx.update(oTable, oKey.key(), order, nOrder);
+            if (!iter.done()) {
+                NewOrderKey noKey{iter.value()};
+                if (noKey.w_id == in.w_id && noKey.d_id == d_id) {
+                    noKeys.push_back(noKey);
+                    continue;
+                }
+            }
+            result.skipped_districts |= uint16_t(1) << (d_id - 1);
+        }
+        std::vector<Future<Tuple>> newOrdersF;
+        std::vector<Future<Tuple>> ordersF;
+        newOrdersF.reserve(noKeys.size());
+        ordersF.reserve(noKeys.size());
+        for (const auto& noKey : noKeys) {
+            OrderKey oKey{in.w_id, noKey.d_id, noKey.o_id};
+            newOrdersF.emplace_back(tx.get(noTable, noKey.key()));
+            ordersF.emplace_back(tx.get(oTable, oKey.key()));
+        }
+        // request order lines and customer of a district as soon as its order arrived
+        std::vector<Tuple> orders;
+        std::vector<std::vector<Future<Tuple>>> orderLinesF(noKeys.size());
+        std::vector<Future<Tuple>> customersF;
+        std::vector<CustomerKey> cKeys;
+        orders.reserve(noKeys.size());
+        customersF.reserve(noKeys.size());
+        cKeys.reserve(noKeys.size());
+        for (size_t i = 0; i < noKeys.size(); ++i) {
+            const auto& noKey = noKeys[i];
+            orders.emplace_back(ordersF[i].get());
+            const auto& order = orders.back();
             auto o_ol_cnt = order.at("o_ol_cnt").value<int16_t>();
-            std::vector<Future<Tuple>> orderLinesF;
-            orderLinesF.reserve(o_ol_cnt);
-            std::vector<tell::db::key_t> ol_keys;
-            ol_keys.reserve(o_ol_cnt);
+            orderLinesF[i].reserve(o_ol_cnt);
             for (decltype(o_ol_cnt) ol_number = 1; ol_number <= o_ol_cnt; ++ol_number) {
-                OrderlineKey olKey(in.w_id, d_id, oKey.o_id, ol_number);
-                auto k = olKey.key();
-                orderLinesF.emplace_back(tx.get(olTable, k));
-                ol_keys.emplace_back(k);
+                OrderlineKey olKey(in.w_id, noKey.d_id, noKey.o_id, ol_number);
+                orderLinesF[i].emplace_back(tx.get(olTable, olKey.key()));
             }
-            CustomerKey cKey{in.w_id, d_id, order.at("o_c_id").value<int32_t>()};
-            auto customerF = tx.get(cTable, cKey.key());
-            auto customer = customerF.get();
+            cKeys.emplace_back(in.w_id, noKey.d_id, order.at("o_c_id").value<int32_t>());
+            customersF.emplace_back(tx.get(cTable, cKeys.back().key()));
+        }
+        // apply the writes district by district
+        for (size_t i = 0; i < noKeys.size(); ++i) {
+            const auto& noKey = noKeys[i];
+            OrderKey oKey{in.w_id, noKey.d_id, noKey.o_id};
+            auto newOrder = newOrdersF[i].get();
+            tx.remove(noTable, noKey.key(), newOrder);
+            const auto& order = orders[i];
+            auto nOrder = order;
+            nOrder.at("o_carrier_id") = Field(in.o_carrier_id);
+            tx.update(oTable, oKey.key(), order, nOrder);
             int64_t amount = 0;
-            for (size_t i = orderLinesF.size(); i > 0; --i) {
-                auto orderline = orderLinesF[i - 1].get();
+            for (size_t j = orderLinesF[i].size(); j > 0; --j) {
+                auto orderline = orderLinesF[i][j - 1].get();
                 auto nOrderline = orderline;
                 amount += orderline.at("ol_amount").value<int32_t>();
                 nOrderline.at("ol_delivery_d") = Field(ol_delivery_d);
-                tx.update(olTable, ol_keys[i - 1], orderline, nOrderline);
+                OrderlineKey olKey(in.w_id, noKey.d_id, noKey.o_id, int16_t(j));
+                tx.update(olTable, olKey.key(), orderline, nOrderline);
             }
+            auto customer = customersF[i].get();
             auto nCustomer = customer;
             nCustomer.at("c_balance") += Field(amount);
             nCustomer.at("c_delivery_cnt") += Field(int16_t(1));
-            tx.update(cTable, cKey.key(), customer, nCustomer);
+            tx.update(cTable, cKeys[i].key(), customer, nCustomer);
         }
+        checkDeadline(tx, deadline);
         tx.commit();
         result.success = true;
+    } catch (DeadlineExceeded& ex) {
+        result.success = false;
+        result.timed_out = true;
+        result.error = ex.what();
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
@@ -0,0 +1,112 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "DeliveryQueue.hpp"
+
+#include <crossbow/logger.hpp>
+
+#include <stdexcept>
+
+namespace tpcc {
+
+DeliveryQueue::DeliveryQueue(boost::asio::io_service& service,
+        tell::db::ClientManager<void>& clientManager,
+        int16_t numWarehouses,
+        size_t capacity,
+        unsigned numFibers,
+        const std::string& logFile)
+    : mService(service)
+    , mClientManager(clientManager)
+    , mTransactions(numWarehouses, false)
+    , mCapacity(capacity)
+    , mFibers(numFibers)
+    , mLog(logFile.c_str())
+{
+    if (!mLog) {
+        throw std::runtime_error("Could not open " + logFile);
+    }
+    mLog << "queued,completed,w_id,o_carrier_id,success,skipped_districts,error\n";
+    mLog.flush();
+}
+
+bool DeliveryQueue::push(const DeliveryIn& args) {
+    if (mQueue.size() >= mCapacity) {
+        return false;
+    }
+    mQueue.push_back(Entry{args, now()});
+    for (size_t i = 0; i < mFibers.size(); ++i) {
+        if (!mFibers[i]) {
+            execute(i);
+            break;
+        }
+    }
+    return true;
+}
+
+void DeliveryQueue::execute(size_t fiber) {
+    if (mQueue.empty()) {
+        return;
+    }
+    auto entry = mQueue.front();
+    mQueue.pop_front();
+    auto transaction = [this, fiber, entry](tell::db::Transaction& tx) {
+        auto res = mTransactions.delivery(tx, entry.args);
+        auto completed = now();
+        mService.post([this, fiber, entry, res, completed]() {
+            mFibers[fiber]->wait();
+            mFibers[fiber].reset(nullptr);
+            if (!res.success) {
+                LOG_ERROR("Deferred delivery failed [error = %1%]", res.error);
+            }
+            // districts without a new order are listed separated by spaces, since
+            // the result file has to report them (TPC-C clause 2.7.2)
+            mLog << entry.queued << ',' << completed << ','
+                << entry.args.w_id << ',' << entry.args.o_carrier_id << ','
+                << (res.success ? "true" : "false") << ',';
+            const char* sep = "";
+            for (int16_t d_id = 1; d_id <= 10; ++d_id) {
+                if (res.success && (res.skipped_districts & (uint16_t(1) << (d_id - 1)))) {
+                    mLog << sep << d_id;
+                    sep = " ";
+                }
+            }
+            // error messages may contain commas and quotes, newlines would
+            // break the one line per delivery
+            mLog << ",\"";
+            for (auto c : res.error) {
+                if (c == '"') {
+                    mLog << "\"\"";
+                } else if (c == '\n' || c == '\r') {
+                    mLog << ' ';
+                } else {
+                    mLog << c;
+                }
+            }
+            mLog << "\"\n";
+            mLog.flush();
+            execute(fiber);
+        });
+    };
+    mFibers[fiber].reset(new tell::db::TransactionFiber<void>(mClientManager.startTransaction(transaction)));
+}
+
+} // namespace tpcc
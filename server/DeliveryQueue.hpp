@@ -0,0 +1,71 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include <common/Protocol.hpp>
+
+#include <telldb/TellDB.hpp>
+
+#include "Transactions.hpp"
+
+namespace tpcc {
+
+// Deferred execution of the Delivery transaction (TPC-C clause 2.7.2).
+// Deliveries are acknowledged as soon as they are queued and executed by a
+// fixed number of background transaction fibers. The queue and completion
+// time of every delivery and the districts it skipped for lack of a new
+// order are written to a result file, one flushed line per delivery. All member functions
+// have to be called from the thread running the io_service.
+class DeliveryQueue {
+    struct Entry {
+        DeliveryIn args;
+        int64_t queued;
+    };
+    boost::asio::io_service& mService;
+    tell::db::ClientManager<void>& mClientManager;
+    Transactions mTransactions;
+    size_t mCapacity;
+    std::deque<Entry> mQueue;
+    std::vector<std::unique_ptr<tell::db::TransactionFiber<void>>> mFibers;
+    std::ofstream mLog;
+public:
+    DeliveryQueue(boost::asio::io_service& service,
+            tell::db::ClientManager<void>& clientManager,
+            int16_t numWarehouses,
+            size_t capacity,
+            unsigned numFibers,
+            const std::string& logFile);
+
+    // Returns false if the queue is full
+    bool push(const DeliveryIn& args);
+private:
+    void execute(size_t fiber);
+};
+
+} // namespace tpcc
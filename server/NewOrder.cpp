@@ -40,26 +40,41 @@ struct NewStock {
 
 }
 
-NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, const NewOrderIn& in)
+NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, const NewOrderIn& in,
+        const Deadline& deadline)
 {
     auto w_id = in.w_id;
     auto d_id = in.d_id;
     auto c_id = in.c_id;
     NewOrderResult result;
+    result.summary_only = in.summary_only;
     try {
+        checkDeadline(tx, deadline);
         Random rnd;
         int16_t o_all_local = 1;
         int16_t o_ol_cnt = rnd->randomWithin<int16_t>(5, 15);
         std::vector<int16_t> ol_supply_w_id(o_ol_cnt);
         for (auto& i : ol_supply_w_id) {
             i = w_id;
-            if (mNumWarehouses > 1 && rnd->randomWithin<int>(1, 100) == 1) {
+            if (mNumWarehouses > 1 && rnd->randomWithin<int>(1, 100) <= in.remote_stock_pct) {
                 o_all_local = 0;
                 while (i == w_id) {
                     i = rnd->randomWithin<int16_t>(1, mNumWarehouses);
                 }
             }
         }
+        // generate random items, 1% of the transactions use an unused item
+        // number on the last line and have to roll back (clause 2.4.1.5)
+        bool rollback = rnd->randomWithin<int>(1, 100) == 1;
+        std::vector<int32_t> ol_i_id;
+        ol_i_id.reserve(o_ol_cnt);
+        for (int16_t i = 0; i < o_ol_cnt; ++i) {
+            auto i_id = rnd->NURand<int32_t>(8191,1,100000);
+            ol_i_id.push_back(i_id);
+        }
+        if (rollback) {
+            ol_i_id.back() = 100001;
+        }
         auto datetime = now();
         auto wTableF = tx.openTable("warehouse");
         auto cTableF = tx.openTable("customer");
@@ -77,12 +92,54 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
         auto cTable = cTableF.get();
         auto wTable = wTableF.get();
         auto iTable = iTableF.get();
+        // get the items - they are checked before we touch district or
+        // stock, so an invalid item number aborts the transaction early
+        std::unordered_map<ItemKey, Future<Tuple>> itemsF;
+        std::unordered_map<ItemKey, Tuple> items;
+        itemsF.reserve(o_ol_cnt);
+        items.reserve(o_ol_cnt);
+        bool validItems = true;
+        for (int16_t i = 0; i < o_ol_cnt; ++i) {
+            auto i_id = ol_i_id[i];
+            // the item table is populated with item numbers 1 to 100000
+            if (i_id < 1 || i_id > 100000) {
+                validItems = false;
+                continue;
+            }
+            ItemKey iKey(i_id);
+            if (itemsF.count(i_id) == 0) {
+                itemsF.emplace(iKey, tx.get(iTable, iKey.key()));
+            }
+        }
+        if (!validItems) {
+            for (auto& p : itemsF) {
+                p.second.get();
+            }
+            tx.rollback();
+            result.success = false;
+            result.error = "Item number is not valid";
+            return result;
+        }
         WarehouseKey wKey(w_id);
         CustomerKey cKey(w_id, d_id, c_id);
         DistrictKey dKey(w_id, d_id);
         auto warehouseF = tx.get(wTable, wKey.key());
         auto customerF = tx.get(cTable, cKey.key());
         auto districtF = tx.get(dTable, dKey.key());
+        // get the stocks
+        std::unordered_map<StockKey, Future<Tuple>> stocksF;
+        std::unordered_map<StockKey, Tuple> stocks;
+        stocksF.reserve(o_ol_cnt);
+        stocks.reserve(o_ol_cnt);
+        for (int16_t i = 0; i < o_ol_cnt; ++i) {
+            StockKey sKey(ol_supply_w_id[i], ol_i_id[i]);
+            if (stocksF.count(sKey) == 0) {
+                stocksF.emplace(sKey, tx.get(sTable, sKey.key()));
+            }
+        }
+        for (auto& p : itemsF) {
+            items.emplace(p.first, p.second.get());
+        }
         auto district = districtF.get();
         auto customer = customerF.get();
         auto warehouse = warehouseF.get();
@@ -109,34 +166,6 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
             {"no_d_id", d_id},
             {"no_w_id", w_id}
         }});
-        // generate random items
-        std::vector<int32_t> ol_i_id;
-        ol_i_id.reserve(o_ol_cnt);
-        for (int16_t i = 0; i < o_ol_cnt; ++i) {
-            auto i_id = rnd->NURand<int32_t>(8191,1,100000);
-            ol_i_id.push_back(i_id);
-        }
-        // get the items
-        // get the stocks
-        std::unordered_map<ItemKey, Future<Tuple>> itemsF;
-        std::unordered_map<ItemKey, Tuple> items;
-        std::unordered_map<StockKey, Future<Tuple>> stocksF;
-        std::unordered_map<StockKey, Tuple> stocks;
-        itemsF.reserve(o_ol_cnt);
-        items.reserve(o_ol_cnt);
-        stocksF.reserve(o_ol_cnt);
-        stocks.reserve(o_ol_cnt);
-        for (int16_t i = 0; i < o_ol_cnt; ++i) {
-            auto i_id = ol_i_id[i];
-            ItemKey iKey(i_id);
-            if (itemsF.count(i_id) == 0) {
-                itemsF.emplace(iKey, tx.get(iTable, iKey.key()));
-            }
-            StockKey sKey(ol_supply_w_id[i], i_id);
-            if (stocksF.count(sKey) == 0) {
-                stocksF.emplace(sKey, tx.get(sTable, sKey.key()));
-            }
-        }
         std::unordered_map<StockKey, NewStock> newStocks;
         for (auto& p : stocksF) {
             auto stock = p.second.get();
@@ -148,9 +177,6 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
             newStocks.emplace(p.first, std::move(nStock));
             stocks.emplace(p.first, std::move(stock));
         }
-        for (auto& p : itemsF) {
-            items.emplace(p.first, p.second.get());
-        }
         // set ol_dist_info key
         crossbow::string ol_dist_info_key;
         if (d_id == 10) {
@@ -194,21 +220,23 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
                 {"ol_dist_info", ol_dist_info}
             }});
             // set Result for this order line
-            const auto& i_data = item.at("i_data").value<crossbow::string>();
-            const auto& s_data = stock.at("s_data").value<crossbow::string>();
-            NewOrderResult::OrderLine lineRes;
-            lineRes.ol_supply_w_id = ol_supply_w_id[i];
-            lineRes.ol_i_id = ol_i_id[i];
-            lineRes.i_name = item.at("i_name").value<crossbow::string>();
-            lineRes.ol_quantity = ol_quantity;
-            lineRes.s_quantity = newStock.s_quantity;
-            lineRes.i_price = i_price;
-            lineRes.ol_amount = ol_amount;
-            lineRes.brand_generic = 'G';
-            if (i_data.find("ORIGINAL") != i_data.npos && s_data.find("ORIGINAL") != s_data.npos) {
-                lineRes.brand_generic = 'B';
+            if (!in.summary_only) {
+                const auto& i_data = item.at("i_data").value<crossbow::string>();
+                const auto& s_data = stock.at("s_data").value<crossbow::string>();
+                NewOrderResult::OrderLine lineRes;
+                lineRes.ol_supply_w_id = ol_supply_w_id[i];
+                lineRes.ol_i_id = ol_i_id[i];
+                lineRes.i_name = item.at("i_name").value<crossbow::string>();
+                lineRes.ol_quantity = ol_quantity;
+                lineRes.s_quantity = newStock.s_quantity;
+                lineRes.i_price = i_price;
+                lineRes.ol_amount = ol_amount;
+                lineRes.brand_generic = 'G';
+                if (i_data.find("ORIGINAL") != i_data.npos && s_data.find("ORIGINAL") != s_data.npos) {
+                    lineRes.brand_generic = 'B';
+                }
+                result.lines.emplace_back(std::move(lineRes));
             }
-            result.lines.emplace_back(std::move(lineRes));
         }
         // update stock-entries
         for (const auto& p : stocks) {
@@ -220,25 +248,23 @@ NewOrderResult Transactions::newOrderTransaction(tell::db::Transaction& tx, cons
             n.at("s_remote_cnt") = Field(nStock.s_remote_cnt);
             tx.update(sTable, p.first.key(), p.second, n);
         }
-        // 1% of transactions need to abort
-        if (rnd->randomWithin<int>(1, 100) == 1) {
-            tx.rollback();
-            result.success = false;
-            result.error = "Item number is not valid";
-            result.lines.clear();
-        } else {
-            // write single-line results
-            result.o_id = o_id;
-            result.o_ol_cnt = o_ol_cnt;
-            result.c_last = customer.at("c_last").value<crossbow::string>();
-            result.c_credit = customer.at("c_credit").value<crossbow::string>();
-            result.c_discount = customer.at("c_discount").value<int32_t>();
-            result.w_tax = warehouse.at("w_tax").value<int32_t>();
-            result.d_tax = district.at("d_tax").value<int32_t>();
-            result.o_entry_d = datetime;
-            result.total_amount = ol_amount_sum * (1 - result.c_discount) * (1 + result.w_tax + result.d_tax);
-            tx.commit();
-        }
+        // write single-line results
+        result.o_id = o_id;
+        result.o_ol_cnt = o_ol_cnt;
+        result.c_last = customer.at("c_last").value<crossbow::string>();
+        result.c_credit = customer.at("c_credit").value<crossbow::string>();
+        result.c_discount = customer.at("c_discount").value<int32_t>();
+        result.w_tax = warehouse.at("w_tax").value<int32_t>();
+        result.d_tax = district.at("d_tax").value<int32_t>();
+        result.o_entry_d = datetime;
+        result.total_amount = ol_amount_sum * (1 - result.c_discount) * (1 + result.w_tax + result.d_tax);
+        checkDeadline(tx, deadline);
+        tx.commit();
+    } catch (DeadlineExceeded& ex) {
+        result.success = false;
+        result.timed_out = true;
+        result.error = ex.what();
+        result.lines.clear();
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
@@ -28,9 +28,10 @@ using namespace tell::db;
 
 namespace tpcc {
 
-OrderStatusResult Transactions::orderStatus(Transaction& tx, const OrderStatusIn& in) {
+OrderStatusResult Transactions::orderStatus(Transaction& tx, const OrderStatusIn& in, const Deadline& deadline) {
     OrderStatusResult result;
     try {
+        checkDeadline(tx, deadline);
         auto oTableF = tx.openTable("order");
         auto olTableF = tx.openTable("order-line");
         auto cTableF = tx.openTable("customer");
@@ -72,8 +73,13 @@ OrderStatusResult Transactions::orderStatus(Transaction& tx, const OrderStatusIn
         for (auto& f : reqs) {
             f.get();
         }
+        checkDeadline(tx, deadline);
         tx.commit();
         result.success = true;
+    } catch (DeadlineExceeded& ex) {
+        result.success = false;
+        result.timed_out = true;
+        result.error = ex.what();
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
@@ -67,9 +67,10 @@ Future<Tuple> Transactions::getCustomer(Transaction& tx,
     return tx.get(customerTable, customerKey.key());
 }
 
-PaymentResult Transactions::payment(tell::db::Transaction& tx, const PaymentIn& in) {
+PaymentResult Transactions::payment(tell::db::Transaction& tx, const PaymentIn& in, const Deadline& deadline) {
     PaymentResult result;
     try {
+        checkDeadline(tx, deadline);
         auto cTableF = tx.openTable("customer");
         auto wTableF = tx.openTable("warehouse");
         auto dTableF = tx.openTable("district");
@@ -137,8 +138,13 @@ PaymentResult Transactions::payment(tell::db::Transaction& tx, const PaymentIn&
             {"h_amount", in.h_amount},
             {"h_data", h_data}
         }});
+        checkDeadline(tx, deadline);
         tx.commit();
         result.success = true;
+    } catch (DeadlineExceeded& ex) {
+        result.success = false;
+        result.timed_out = true;
+        result.error = ex.what();
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
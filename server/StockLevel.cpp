@@ -21,14 +21,19 @@
  *     Lucas Braun <braunl@inf.ethz.ch>
  */
 #include "Transactions.hpp"
+#include "CreateSchema.hpp"
 
 using namespace tell::db;
 
 namespace tpcc {
 
-StockLevelResult Transactions::stockLevel(Transaction& tx, const StockLevelIn& in) {
+StockLevelResult Transactions::stockLevel(Transaction& tx, const StockLevelIn& in, const Deadline& deadline) {
+    if (mStockLevelScan) {
+        return stockLevelScan(tx, in, deadline);
+    }
     StockLevelResult result;
     try {
+        checkDeadline(tx, deadline);
         auto dTableF = tx.openTable("district");
         auto oTableF = tx.openTable("order");
         auto olTableF = tx.openTable("order-line");
@@ -81,9 +86,76 @@ StockLevelResult Transactions::stockLevel(Transaction& tx, const StockLevelIn& i
                 ++result.low_stock;
             }
         }
+        checkDeadline(tx, deadline);
         tx.commit();
         result.success = true;
         return result;
+    } catch (DeadlineExceeded& ex) {
+        result.success = false;
+        result.timed_out = true;
+        result.error = ex.what();
+    } catch (std::exception& ex) {
+        result.success = false;
+        result.error = ex.what();
+    }
+    return result;
+}
+
+StockLevelResult Transactions::stockLevelScan(Transaction& tx, const StockLevelIn& in, const Deadline& deadline) {
+    StockLevelResult result;
+    try {
+        checkDeadline(tx, deadline);
+        auto dTableF = tx.openTable("district");
+        auto olTableF = tx.openTable("order-line");
+        auto sTableF = tx.openTable("stock");
+        auto sTable = sTableF.get();
+        auto olTable = olTableF.get();
+        auto dTable = dTableF.get();
+
+        // get District
+        DistrictKey dKey{in.w_id, in.d_id};
+        auto districtF = tx.get(dTable, dKey.key());
+        auto district = districtF.get();
+        auto d_next_o_id = district.at("d_next_o_id").value<int32_t>();
+
+        // scan the order-line index for the 20 newest orders, ol_i_id is
+        // part of the index key so we do not need to fetch any order lines
+        auto iter = tx.lower_bound(olTable, "order-line-idx", {
+                Field(in.w_id)
+                , Field(in.d_id)
+                , Field(int32_t(d_next_o_id - 20))
+                , Field(int16_t(0))
+                , Field(int32_t(0))
+                });
+        std::unordered_map<int32_t, Future<Tuple>> stocksF;
+        for (; !iter.done(); iter.next()) {
+            auto k = iter.key();
+            if (k[0].value<int16_t>() != in.w_id || k[1].value<int16_t>() != in.d_id
+                    || k[2].value<int32_t>() >= d_next_o_id) {
+                break;
+            }
+            auto ol_i_id = k[4].value<int32_t>();
+            if (stocksF.count(ol_i_id) == 0) {
+                StockKey sKey{in.w_id, ol_i_id};
+                stocksF.emplace(ol_i_id, tx.get(sTable, sKey.key()));
+            }
+        }
+        // count low_stock
+        result.low_stock = 0;
+        for (auto& p : stocksF) {
+            auto stock = p.second.get();
+            auto quantity = stock.at("s_quantity").value<int32_t>();
+            if (quantity < in.threshold) {
+                ++result.low_stock;
+            }
+        }
+        checkDeadline(tx, deadline);
+        tx.commit();
+        result.success = true;
+    } catch (DeadlineExceeded& ex) {
+        result.success = false;
+        result.timed_out = true;
+        result.error = ex.what();
     } catch (std::exception& ex) {
         result.success = false;
         result.error = ex.what();
@@ -21,6 +21,9 @@
  *     Lucas Braun <braunl@inf.ethz.ch>
  */
 #pragma once
+#include <chrono>
+#include <stdexcept>
+
 #include <telldb/Transaction.hpp>
 #include <common/Protocol.hpp>
 #include <common/Util.hpp>
@@ -28,18 +31,60 @@
 
 namespace tpcc {
 
+// When a transaction has to be committed by, taken from the deadline_ms of
+// a request when it arrives
+class Deadline {
+    std::chrono::steady_clock::time_point mEnd;
+    bool mSet = false;
+public:
+    Deadline() = default;
+    explicit Deadline(uint32_t ms)
+        : mEnd(std::chrono::steady_clock::now() + std::chrono::milliseconds(ms))
+        , mSet(ms != 0)
+    {}
+    bool expired() const {
+        return mSet && std::chrono::steady_clock::now() >= mEnd;
+    }
+};
+
+class DeadlineExceeded : public std::runtime_error {
+public:
+    DeadlineExceeded()
+        : std::runtime_error("Deadline exceeded")
+    {}
+};
+
 class Transactions {
     int16_t mNumWarehouses;
+    bool mStockLevelScan;
     Random_t& rnd;
 public:
-    Transactions(int16_t numWarehouses) : mNumWarehouses(numWarehouses), rnd(*Random()) {}
+    Transactions(int16_t numWarehouses, bool stockLevelScan)
+        : mNumWarehouses(numWarehouses)
+        , mStockLevelScan(stockLevelScan)
+        , rnd(*Random())
+    {}
 public:
-    NewOrderResult newOrderTransaction(tell::db::Transaction& tx, const NewOrderIn& in);
-    PaymentResult payment(tell::db::Transaction& tx, const PaymentIn& in);
-    OrderStatusResult orderStatus(tell::db::Transaction& tx, const OrderStatusIn& in);
-    DeliveryResult delivery(tell::db::Transaction& tx, const DeliveryIn& in);
-    StockLevelResult stockLevel(tell::db::Transaction& tx, const StockLevelIn& in);
+    // A transaction checks its deadline before it starts and before it
+    // commits. If it passed, the transaction is rolled back and the result
+    // is marked as timed out.
+    NewOrderResult newOrderTransaction(tell::db::Transaction& tx, const NewOrderIn& in,
+            const Deadline& deadline = Deadline());
+    PaymentResult payment(tell::db::Transaction& tx, const PaymentIn& in, const Deadline& deadline = Deadline());
+    OrderStatusResult orderStatus(tell::db::Transaction& tx, const OrderStatusIn& in,
+            const Deadline& deadline = Deadline());
+    DeliveryResult delivery(tell::db::Transaction& tx, const DeliveryIn& in, const Deadline& deadline = Deadline());
+    StockLevelResult stockLevel(tell::db::Transaction& tx, const StockLevelIn& in,
+            const Deadline& deadline = Deadline());
 private:
+    StockLevelResult stockLevelScan(tell::db::Transaction& tx, const StockLevelIn& in, const Deadline& deadline);
+    // throws DeadlineExceeded after rolling back tx if the deadline passed
+    void checkDeadline(tell::db::Transaction& tx, const Deadline& deadline) {
+        if (deadline.expired()) {
+            tx.rollback();
+            throw DeadlineExceeded();
+        }
+    }
     tell::db::Future<tell::db::Tuple> getCustomer(tell::db::Transaction& tx,
             bool selectByLastName,
             const crossbow::string& c_last,
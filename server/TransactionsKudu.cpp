@@ -25,6 +25,7 @@
 #include <kudu/client/row_result.h>
 
 #include <boost/unordered_map.hpp>
+#include <set>
 
 namespace tpcc {
 
@@ -32,6 +33,7 @@ using namespace kudu;
 using namespace kudu::client;
 
 using ScannerList = std::vector<std::unique_ptr<KuduScanner>>;
+using Projection = std::vector<std::string>;
 
 template<class T>
 struct is_string {
@@ -96,9 +98,10 @@ void addPredicates(KuduTable& table, KuduScanner& scanner, const Args&... args)
 }
 
 template<class... Args>
-KuduRowResult get(KuduTable& table, ScannerList& scanners, const Args&... args) {
+KuduRowResult get(KuduTable& table, ScannerList& scanners, const Projection& projection, const Args&... args) {
     scanners.emplace_back(new KuduScanner(&table));
     auto& scanner = *scanners.back();
+    assertOk(scanner.SetProjectedColumns(projection));
     addPredicates(table, scanner, args...);
     assertOk(scanner.Open());
     assert(scanner.HasMoreRows());
@@ -138,6 +141,7 @@ struct NewStock {
 
 NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const NewOrderIn& in) {
     NewOrderResult result;
+    result.summary_only = in.summary_only;
     std::tr1::shared_ptr<KuduTable> wTable;
     std::tr1::shared_ptr<KuduTable> cTable;
     std::tr1::shared_ptr<KuduTable> dTable;
@@ -155,32 +159,64 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
     assertOk(session.client()->OpenTable("order-line", &olTable));
     assertOk(session.client()->OpenTable("stock", &sTable));
 
-    ScannerList scanners;
-    auto warehouse = get(*wTable, scanners, "w_id", in.w_id);
-    auto customer = get(*cTable, scanners, "c_w_id", in.w_id, "c_d_id", in.d_id, "c_id", in.c_id);
-    auto district = get(*dTable, scanners, "d_w_id", in.w_id, "d_id", in.d_id);
-
-    int32_t d_next_o_id;
-    assertOk(district.GetInt32("d_next_o_id", &d_next_o_id));
-    std::unique_ptr<KuduUpdate> update(dTable->NewUpdate());
-    assertOk(update->mutable_row()->SetInt32("d_next_o_id", d_next_o_id + 1));
-    assertOk(update->mutable_row()->SetInt16("d_w_id", in.w_id));
-    assertOk(update->mutable_row()->SetInt16("d_id", in.d_id));
-    assertOk(session.Apply(update.release()));
-
-    auto o_id = d_next_o_id;
     int16_t o_all_local = 1;
     int16_t o_ol_cnt = rnd.randomWithin<int16_t>(5, 15);
     std::vector<int16_t> ol_supply_w_id(o_ol_cnt);
     for (auto& i : ol_supply_w_id) {
         i = in.w_id;
-        if (mNumWarehouses > 1 && rnd.randomWithin<int>(1, 100) == 1) {
+        if (mNumWarehouses > 1 && rnd.randomWithin<int>(1, 100) <= in.remote_stock_pct) {
             o_all_local = 0;
             while (i == in.w_id) {
                 i = rnd.randomWithin<int16_t>(1, mNumWarehouses);
             }
         }
     }
+    // generate random items, 1% of the transactions use an unused item
+    // number on the last line and have to roll back (clause 2.4.1.5)
+    bool rollback = rnd.randomWithin<int>(1, 100) == 1;
+    std::vector<int32_t> ol_i_id;
+    ol_i_id.reserve(o_ol_cnt);
+    for (int16_t i = 0; i < o_ol_cnt; ++i) {
+        auto i_id = rnd.NURand<int32_t>(8191,1,100000);
+        ol_i_id.push_back(i_id);
+    }
+    if (rollback) {
+        ol_i_id.back() = 100001;
+    }
+
+    ScannerList scanners;
+    // get the items - they are checked before we touch district or stock,
+    // so an invalid item number aborts the transaction early
+    Projection itemProjection{"i_price", "i_name", "i_data"};
+    boost::unordered_map<int32_t, KuduRowResult> items;
+    items.reserve(o_ol_cnt);
+    for (int16_t i = 0; i < o_ol_cnt; ++i) {
+        auto i_id = ol_i_id[i];
+        // the item table is populated with item numbers 1 to 100000
+        if (i_id < 1 || i_id > 100000) {
+            result.success = false;
+            result.error = "Item number is not valid";
+            return result;
+        }
+        if (items.count(i_id) == 0) {
+            items.emplace(i_id, get(*iTable, scanners, itemProjection, "i_id", i_id));
+        }
+    }
+
+    auto warehouse = get(*wTable, scanners, {"w_tax"}, "w_id", in.w_id);
+    auto customer = get(*cTable, scanners, {"c_discount", "c_last", "c_credit"},
+            "c_w_id", in.w_id, "c_d_id", in.d_id, "c_id", in.c_id);
+    auto district = get(*dTable, scanners, {"d_next_o_id", "d_tax"}, "d_w_id", in.w_id, "d_id", in.d_id);
+
+    int32_t d_next_o_id;
+    assertOk(district.GetInt32("d_next_o_id", &d_next_o_id));
+    std::unique_ptr<KuduUpdate> update(dTable->NewUpdate());
+    assertOk(update->mutable_row()->SetInt32("d_next_o_id", d_next_o_id + 1));
+    assertOk(update->mutable_row()->SetInt16("d_w_id", in.w_id));
+    assertOk(update->mutable_row()->SetInt16("d_id", in.d_id));
+    assertOk(session.Apply(update.release()));
+
+    auto o_id = d_next_o_id;
     std::vector<std::unique_ptr<KuduWriteOperation>> operations;
     auto datetime = now();
     std::unique_ptr<KuduInsert> ins(oTable->NewInsert());
@@ -200,26 +236,24 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
     set(*ins, "no_w_id", in.w_id);
     operations.emplace_back(ins.release());
 
-    std::vector<int32_t> ol_i_id;
-    ol_i_id.reserve(o_ol_cnt);
-    for (int16_t i = 0; i < o_ol_cnt; ++i) {
-        auto i_id = rnd.NURand<int32_t>(8191,1,100000);
-        ol_i_id.push_back(i_id);
+    // set ol_dist_info key
+    std::string ol_dist_info_key;
+    if (in.d_id == 10) {
+        ol_dist_info_key ="s_dist_10";
+    } else {
+        ol_dist_info_key = "s_dist_0" + std::to_string(in.d_id);
     }
-    // get the items
-    // get the stocks
-    boost::unordered_map<int32_t, KuduRowResult> items;
+    // get the stocks - only the district info of our district is needed
+    Projection stockProjection{"s_w_id", "s_i_id", "s_quantity", "s_ytd", "s_order_cnt", "s_remote_cnt",
+        "s_data", ol_dist_info_key};
     boost::unordered_map<std::tuple<int16_t, int32_t>, KuduRowResult> stocks;
-    items.reserve(o_ol_cnt);
     stocks.reserve(o_ol_cnt);
     for (int16_t i = 0; i < o_ol_cnt; ++i) {
         auto i_id = ol_i_id[i];
-        if (items.count(i_id) == 0) {
-            items.emplace(i_id, get(*iTable, scanners, "i_id", i_id));
-        }
         auto sKey = std::make_tuple(ol_supply_w_id[i], i_id);
         if (stocks.count(sKey) == 0) {
-            stocks.emplace(sKey, get(*sTable, scanners, "s_w_id", std::get<0>(sKey), "s_i_id", std::get<1>(sKey)));
+            stocks.emplace(sKey, get(*sTable, scanners, stockProjection,
+                        "s_w_id", std::get<0>(sKey), "s_i_id", std::get<1>(sKey)));
         }
     }
     boost::unordered_map<std::tuple<int16_t, int32_t>, NewStock> newStocks;
@@ -234,13 +268,6 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
         assertOk(stock.GetInt16("s_remote_cnt", &nStock.s_remote_cnt));
         newStocks.emplace(p.first, std::move(nStock));
     }
-    // set ol_dist_info key
-    std::string ol_dist_info_key;
-    if (in.d_id == 10) {
-        ol_dist_info_key ="s_dist_10";
-    } else {
-        ol_dist_info_key = "s_dist_0" + std::to_string(in.d_id);
-    }
     int32_t ol_amount_sum = 0;
     // insert the order lines
     std::vector<std::string> strings;
@@ -281,26 +308,28 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
         set(*ins, "ol_amount", ol_amount);
         set(*ins, "ol_dist_info", ol_dist_info);
         // set Result for this order line
-        Slice i_data, s_data;
-        assertOk(item.GetString("i_data", &i_data));
-        assertOk(stock.GetString("s_data", &s_data));
-        NewOrderResult::OrderLine lineRes;
-        lineRes.ol_supply_w_id = ol_supply_w_id[i];
-        lineRes.ol_i_id = ol_i_id[i];
-        Slice i_name;
-        assertOk(item.GetString("i_name", &i_name));
-        lineRes.i_name = i_name.ToString();
-        lineRes.ol_quantity = ol_quantity;
-        lineRes.s_quantity = newStock.s_quantity;
-        lineRes.i_price = i_price;
-        lineRes.ol_amount = ol_amount;
-        lineRes.brand_generic = 'G';
-        auto i_data_str = i_data.ToString();
-        auto s_data_str = s_data.ToString();
-        if (i_data_str.find("ORIGINAL") != i_data_str.npos && s_data_str.find("ORIGINAL") != s_data_str.npos) {
-            lineRes.brand_generic = 'B';
+        if (!in.summary_only) {
+            Slice i_data, s_data;
+            assertOk(item.GetString("i_data", &i_data));
+            assertOk(stock.GetString("s_data", &s_data));
+            NewOrderResult::OrderLine lineRes;
+            lineRes.ol_supply_w_id = ol_supply_w_id[i];
+            lineRes.ol_i_id = ol_i_id[i];
+            Slice i_name;
+            assertOk(item.GetString("i_name", &i_name));
+            lineRes.i_name = i_name.ToString();
+            lineRes.ol_quantity = ol_quantity;
+            lineRes.s_quantity = newStock.s_quantity;
+            lineRes.i_price = i_price;
+            lineRes.ol_amount = ol_amount;
+            lineRes.brand_generic = 'G';
+            auto i_data_str = i_data.ToString();
+            auto s_data_str = s_data.ToString();
+            if (i_data_str.find("ORIGINAL") != i_data_str.npos && s_data_str.find("ORIGINAL") != s_data_str.npos) {
+                lineRes.brand_generic = 'B';
+            }
+            result.lines.emplace_back(std::move(lineRes));
         }
-        result.lines.emplace_back(std::move(lineRes));
     }
     // update stock-entries
     for (const auto& p : stocks) {
@@ -315,33 +344,24 @@ NewOrderResult Transactions::newOrderTransaction(KuduSession& session, const New
         set(*upd, "s_remote_cnt", nStock.s_remote_cnt);
         operations.emplace_back(std::move(upd));
     }
-    // 1% of transactions need to abort
-    if (rnd.randomWithin<int>(1, 100) == 1) {
-        result.success = false;
-        result.error = "Item number is not valid";
-        result.lines.clear();
-    } else {
-        // write single-line results
-        result.o_id = o_id;
-        result.o_ol_cnt = o_ol_cnt;
-        Slice c_last, c_credit;
-        assertOk(customer.GetString("c_last", &c_last));
-        assertOk(customer.GetString("c_credit", &c_credit));
-        result.c_last = c_last.ToString();
-        result.c_credit = c_credit.ToString();
-        assertOk(customer.GetInt32("c_discount", &result.c_discount));
-        assertOk(warehouse.GetInt32("w_tax", &result.w_tax));
-        assertOk(district.GetInt32("d_tax", &result.d_tax));
-        result.o_entry_d = datetime;
-        result.total_amount = ol_amount_sum * (1 - result.c_discount) * (1 + result.w_tax + result.d_tax);
-    }
-
-    if (result.success) {
-        for (auto& op : operations) {
-            assertOk(session.Apply(op.release()));
-        }
-        assertOk(session.Flush());
+    // write single-line results
+    result.o_id = o_id;
+    result.o_ol_cnt = o_ol_cnt;
+    Slice c_last, c_credit;
+    assertOk(customer.GetString("c_last", &c_last));
+    assertOk(customer.GetString("c_credit", &c_credit));
+    result.c_last = c_last.ToString();
+    result.c_credit = c_credit.ToString();
+    assertOk(customer.GetInt32("c_discount", &result.c_discount));
+    assertOk(warehouse.GetInt32("w_tax", &result.w_tax));
+    assertOk(district.GetInt32("d_tax", &result.d_tax));
+    result.o_entry_d = datetime;
+    result.total_amount = ol_amount_sum * (1 - result.c_discount) * (1 + result.w_tax + result.d_tax);
+
+    for (auto& op : operations) {
+        assertOk(session.Apply(op.release()));
     }
+    assertOk(session.Flush());
     return result;
 }
 
@@ -360,12 +380,14 @@ KuduRowResult getCustomer(KuduSession& session,
         int32_t c_id,
         std::tr1::shared_ptr<KuduTable>& customerTable,
         std::tr1::shared_ptr<KuduTable>& idxTable,
+        const Projection& projection,
         CustomerKey& customerKey)
 {
     std::string c_last(c_last_str.begin(), c_last_str.end());
     scanners.emplace_back(new KuduScanner(customerTable.get()));
     auto& scanner = *scanners.back();
     if (selectByLastName) {
+        assertOk(scanner.SetProjectedColumns({"c_last", "c_w_id", "c_d_id", "c_id"}));
         addPredicates(*idxTable, scanner, "c_w_id", c_w_id, "c_d_id", c_d_id, "c_last", c_last);
         scanner.Open();
         std::vector<KuduRowResult> rows;
@@ -398,7 +420,7 @@ KuduRowResult getCustomer(KuduSession& session,
     } else {
         customerKey = CustomerKey{c_w_id, c_d_id, c_id};
     }
-    return get(*customerTable, scanners, "c_w_id", customerKey.c_w_id, "c_d_id", customerKey.c_d_id, "c_id", customerKey.c_id);
+    return get(*customerTable, scanners, projection, "c_w_id", customerKey.c_w_id, "c_d_id", customerKey.c_d_id, "c_id", customerKey.c_id);
 }
 
 struct OrderKey {
@@ -431,10 +453,12 @@ OrderStatusResult Transactions::orderStatus(KuduSession& session, const OrderSta
                 in.c_id,
                 cTable,
                 idxTable,
+                {"c_balance", "c_first", "c_middle", "c_last"},
                 cKey);
         // get newest order
         scanners.emplace_back(new KuduScanner(idxOTable.get()));
         auto& oScanner = *scanners.back();
+        assertOk(oScanner.SetProjectedColumns({"o_id"}));
         addPredicates(*idxOTable, oScanner, "o_w_id", in.w_id, "o_d_id", in.d_id, "o_c_id", cKey.c_id);
         // we need to get the last one - since Kudu does not support reverse iteration,
         // we need to iterate through all orders
@@ -455,14 +479,15 @@ OrderStatusResult Transactions::orderStatus(KuduSession& session, const OrderSta
             result.error = errstream.str();
             return result;
         }
-        auto order = get(*oTable, scanners, "o_w_id", oKey.o_w_id, "o_d_id", oKey.o_d_id, "o_id", oKey.o_id);
+        auto order = get(*oTable, scanners, {"o_ol_cnt"}, "o_w_id", oKey.o_w_id, "o_d_id", oKey.o_d_id, "o_id", oKey.o_id);
         int16_t ol_cnt;
         assertOk(order.GetInt16("o_ol_cnt", &ol_cnt));
         // To get the order lines, we could use an index - but this is not necessary,
         // since we can generate all primary keys instead
+        Projection olProjection{"ol_i_id", "ol_supply_w_id", "ol_quantity", "ol_amount", "ol_delivery_d"};
         for (decltype(ol_cnt) i = 1; i <= ol_cnt; ++i) {
             auto ol_number = i;
-            get(*olTable, scanners, "ol_w_id", in.w_id, "ol_d_id", in.d_id, "ol_o_id", oKey.o_id, "ol_number", ol_number);
+            get(*olTable, scanners, olProjection, "ol_w_id", in.w_id, "ol_d_id", in.d_id, "ol_o_id", oKey.o_id, "ol_number", ol_number);
         }
         result.success = true;
     } catch (std::exception& ex) {
@@ -490,10 +515,13 @@ PaymentResult Transactions::payment(KuduSession& session, const PaymentIn& in) {
         CustomerKey customerKey{0, 0, 0};
         ScannerList scanners;
         std::vector<std::unique_ptr<KuduWriteOperation>> operations;
+        // c_data is only needed for bad-credit customers, we fetch it separately
         auto customer = getCustomer(session, scanners, in.selectByLastName, in.c_last,
-               in.c_w_id, in.c_d_id, in.c_id, cTable, idxCTable, customerKey);
-        auto district = get(*dTable, scanners, "d_w_id", in.w_id, "d_id", in.d_id);
-        auto warehouse = get(*wTable, scanners, "w_id", in.w_id);
+               in.c_w_id, in.c_d_id, in.c_id, cTable, idxCTable,
+               {"c_w_id", "c_d_id", "c_id", "c_balance", "c_ytd_payment", "c_payment_cnt", "c_credit"},
+               customerKey);
+        auto district = get(*dTable, scanners, {"d_ytd", "d_name"}, "d_w_id", in.w_id, "d_id", in.d_id);
+        auto warehouse = get(*wTable, scanners, {"w_ytd", "w_name"}, "w_id", in.w_id);
 
         std::unique_ptr<KuduWriteOperation> upd(wTable->NewUpdate());
         set(*upd, "w_id", in.w_id);
@@ -526,7 +554,6 @@ PaymentResult Transactions::payment(KuduSession& session, const PaymentIn& in) {
             assertOk(customer.GetInt64("c_balance", &c_balance));
             assertOk(customer.GetInt64("c_ytd_payment", &c_ytd_payment));
             assertOk(customer.GetInt16("c_payment_cnt", &c_payment_cnt));
-            assertOk(customer.GetInt64("c_balance", &c_balance));
             assertOk(customer.GetString("c_credit", &c_credit));
 
             set(*upd, "c_w_id", c_w_id);
@@ -540,8 +567,9 @@ PaymentResult Transactions::payment(KuduSession& session, const PaymentIn& in) {
                     "," + std::to_string(c_d_id) + "," + std::to_string(c_w_id) +
                     "," + std::to_string(in.d_id) + "," + std::to_string(in.w_id) +
                     "," + std::to_string(in.h_amount);
+                auto cData = get(*cTable, scanners, {"c_data"}, "c_w_id", c_w_id, "c_d_id", c_d_id, "c_id", c_id);
                 Slice c_data_str;
-                assertOk(customer.GetString("c_data", &c_data_str));
+                assertOk(cData.GetString("c_data", &c_data_str));
                 strings.emplace_back(c_data_str.ToString());
                 auto& c_data = strings.back();
                 c_data.insert(0, histInfo);
@@ -610,6 +638,7 @@ DeliveryResult Transactions::delivery(KuduSession& session, const DeliveryIn& in
             ScannerList scanners;
             scanners.emplace_back(new KuduScanner(noTable.get()));
             auto& scanner = *scanners.back();
+            assertOk(scanner.SetProjectedColumns({"no_o_id"}));
             addPredicates(*noTable, scanner, "no_w_id", in.w_id, "no_d_id", d_id);
             scanner.Open();
             assert(scanner.HasMoreRows());
@@ -626,7 +655,7 @@ DeliveryResult Transactions::delivery(KuduSession& session, const DeliveryIn& in
             operations.emplace_back(del.release());
 
             int32_t c_id;
-            auto order = get(*oTable, localScanners, "o_w_id", in.w_id, "o_d_id", d_id, "o_id", no_o_id);
+            auto order = get(*oTable, localScanners, {"o_c_id", "o_ol_cnt"}, "o_w_id", in.w_id, "o_d_id", d_id, "o_id", no_o_id);
             assertOk(order.GetInt32("o_c_id", &c_id));
             std::unique_ptr<KuduUpdate> upd(oTable->NewUpdate());
             set(*upd, "o_w_id", in.w_id);
@@ -639,6 +668,7 @@ DeliveryResult Transactions::delivery(KuduSession& session, const DeliveryIn& in
             assertOk(order.GetInt16("o_ol_cnt", &o_ol_cnt));
             localScanners.emplace_back(new KuduScanner(olTable.get()));
             auto& olScanner = localScanners.back();
+            assertOk(olScanner->SetProjectedColumns({"ol_number", "ol_amount"}));
             addPredicates(*olTable, *olScanner, "ol_w_id", in.w_id, "ol_d_id", d_id, "ol_o_id", no_o_id);
             olScanner->Open();
             std::vector<KuduRowResult> ols;
@@ -662,7 +692,7 @@ DeliveryResult Transactions::delivery(KuduSession& session, const DeliveryIn& in
                 }
             }
 
-            auto customer = get(*cTable, localScanners, "c_w_id", in.w_id, "c_d_id", d_id, "c_id", c_id);
+            auto customer = get(*cTable, localScanners, {"c_balance", "c_delivery_cnt"}, "c_w_id", in.w_id, "c_d_id", d_id, "c_id", c_id);
             int64_t c_balance;
             int16_t c_delivery_cnt;
             assertOk(customer.GetInt64("c_balance", &c_balance));
@@ -692,6 +722,9 @@ DeliveryResult Transactions::delivery(KuduSession& session, const DeliveryIn& in
 }
 
 StockLevelResult Transactions::stockLevel(KuduSession& session, const StockLevelIn& in) {
+    if (mStockLevelScan) {
+        return stockLevelScan(session, in);
+    }
     StockLevelResult result;
     result.low_stock = 0;
     try {
@@ -706,12 +739,13 @@ StockLevelResult Transactions::stockLevel(KuduSession& session, const StockLevel
 
         ScannerList scanners;
         // get District
-        auto district = get(*dTable, scanners, "d_w_id", in.w_id, "d_id", in.d_id);
+        auto district = get(*dTable, scanners, {"d_next_o_id"}, "d_w_id", in.w_id, "d_id", in.d_id);
         int32_t d_next_o_id;
         assertOk(district.GetInt32("d_next_o_id", &d_next_o_id));
 
         scanners.emplace_back(new KuduScanner(olTable.get()));
         auto& olScanner = scanners.back();
+        assertOk(olScanner->SetProjectedColumns({"ol_i_id"}));
         addPredicates(*olTable, *olScanner, "ol_w_id", in.w_id, "ol_d_id", in.d_id);
         assertOk(olScanner->AddConjunctPredicate(olTable->NewComparisonPredicate("ol_o_id", KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(d_next_o_id - 20))));
         olScanner->Open();
@@ -726,6 +760,7 @@ StockLevelResult Transactions::stockLevel(KuduSession& session, const StockLevel
                 int32_t ol_i_id;
                 assertOk(row.GetInt32("ol_i_id", &ol_i_id));
                 scanner.reset(new KuduScanner(sTable.get()));
+                assertOk(scanner->SetProjectedColumns({"s_quantity"}));
                 addPredicates(*sTable, *scanner, "s_w_id", in.w_id, "s_i_id", ol_i_id);
                 scanner->Open();
                 std::vector<KuduRowResult> stocks;
@@ -750,4 +785,94 @@ StockLevelResult Transactions::stockLevel(KuduSession& session, const StockLevel
     return result;
 }
 
+StockLevelResult Transactions::stockLevelScan(KuduSession& session, const StockLevelIn& in) {
+    StockLevelResult result;
+    result.low_stock = 0;
+    try {
+        std::tr1::shared_ptr<KuduTable> sTable;
+        std::tr1::shared_ptr<KuduTable> olTable;
+        std::tr1::shared_ptr<KuduTable> dTable;
+        session.client()->OpenTable("district", &dTable);
+        session.client()->OpenTable("order-line", &olTable);
+        session.client()->OpenTable("stock", &sTable);
+
+        ScannerList scanners;
+        // get District
+        auto district = get(*dTable, scanners, {"d_next_o_id"}, "d_w_id", in.w_id, "d_id", in.d_id);
+        int32_t d_next_o_id;
+        assertOk(district.GetInt32("d_next_o_id", &d_next_o_id));
+
+        // one range scan over the order-line primary key for [d_next_o_id-20, d_next_o_id)
+        scanners.emplace_back(new KuduScanner(olTable.get()));
+        auto& olScanner = *scanners.back();
+        assertOk(olScanner.SetProjectedColumns({"ol_i_id"}));
+        addPredicates(*olTable, olScanner, "ol_w_id", in.w_id, "ol_d_id", in.d_id);
+        assertOk(olScanner.AddConjunctPredicate(olTable->NewComparisonPredicate("ol_o_id",
+                        KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(d_next_o_id - 20))));
+        assertOk(olScanner.AddConjunctPredicate(olTable->NewComparisonPredicate("ol_o_id",
+                        KuduPredicate::LESS_EQUAL, KuduValue::FromInt(d_next_o_id - 1))));
+        assertOk(olScanner.Open());
+        std::set<int32_t> items;
+        std::vector<KuduRowResult> rows;
+        while (olScanner.HasMoreRows()) {
+            assertOk(olScanner.NextBatch(&rows));
+            for (auto& row : rows) {
+                int32_t ol_i_id;
+                assertOk(row.GetInt32("ol_i_id", &ol_i_id));
+                items.insert(ol_i_id);
+            }
+        }
+        if (items.empty()) {
+            result.success = true;
+            return result;
+        }
+
+        // Kudu has no IN-list predicate: scan the stock primary key only for the
+        // item ids we collected, merging ids that lie close together into one
+        // small range. All scanners are opened before any is drained, so the
+        // tablet servers work on them concurrently.
+        constexpr int32_t maxGap = 16;
+        std::vector<std::pair<int32_t, int32_t>> ranges;
+        for (auto i : items) {
+            if (!ranges.empty() && i - ranges.back().second <= maxGap) {
+                ranges.back().second = i;
+            } else {
+                ranges.emplace_back(i, i);
+            }
+        }
+        auto first = scanners.size();
+        for (auto& range : ranges) {
+            scanners.emplace_back(new KuduScanner(sTable.get()));
+            auto& sScanner = *scanners.back();
+            assertOk(sScanner.SetProjectedColumns({"s_i_id"}));
+            addPredicates(*sTable, sScanner, "s_w_id", in.w_id);
+            assertOk(sScanner.AddConjunctPredicate(sTable->NewComparisonPredicate("s_i_id",
+                            KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(range.first))));
+            assertOk(sScanner.AddConjunctPredicate(sTable->NewComparisonPredicate("s_i_id",
+                            KuduPredicate::LESS_EQUAL, KuduValue::FromInt(range.second))));
+            assertOk(sScanner.AddConjunctPredicate(sTable->NewComparisonPredicate("s_quantity",
+                            KuduPredicate::LESS_EQUAL, KuduValue::FromInt(in.threshold - 1))));
+            assertOk(sScanner.Open());
+        }
+        for (auto j = first; j < scanners.size(); ++j) {
+            auto& sScanner = *scanners[j];
+            while (sScanner.HasMoreRows()) {
+                assertOk(sScanner.NextBatch(&rows));
+                for (auto& row : rows) {
+                    int32_t s_i_id;
+                    assertOk(row.GetInt32("s_i_id", &s_i_id));
+                    if (items.count(s_i_id)) {
+                        ++result.low_stock;
+                    }
+                }
+            }
+        }
+        result.success = true;
+    } catch (std::exception& ex) {
+        result.success = false;
+        result.error = ex.what();
+    }
+    return result;
+}
+
 } // namespace tpcc
@@ -29,9 +29,14 @@ namespace tpcc {
 
 class Transactions {
     int16_t mNumWarehouses;
+    bool mStockLevelScan;
     Random_t& rnd;
 public:
-    Transactions(int16_t numWarehouses) : mNumWarehouses(numWarehouses), rnd(*Random()) {}
+    Transactions(int16_t numWarehouses, bool stockLevelScan)
+        : mNumWarehouses(numWarehouses)
+        , mStockLevelScan(stockLevelScan)
+        , rnd(*Random())
+    {}
 public:
     NewOrderResult newOrderTransaction(kudu::client::KuduSession& session, const NewOrderIn& in);
     PaymentResult payment(kudu::client::KuduSession& session, const PaymentIn& in);
@@ -39,6 +44,7 @@ public:
     DeliveryResult delivery(kudu::client::KuduSession& session, const DeliveryIn& in);
     StockLevelResult stockLevel(kudu::client::KuduSession& session, const StockLevelIn& in);
 private:
+    StockLevelResult stockLevelScan(kudu::client::KuduSession& session, const StockLevelIn& in);
     //tell::db::Future<tell::db::Tuple> getCustomer(kudu::client::KuduSession& tx,
     //        bool selectByLastName,
     //        const crossbow::string& c_last,
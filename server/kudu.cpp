@@ -49,25 +49,26 @@ void assertOk(kudu::Status status) {
 using Session = std::tr1::shared_ptr<kudu::client::KuduSession>;
 
 class Connection {
-    boost::asio::ip::tcp::socket mSocket;
+    TransportStream mStream;
     server::Server<Connection> mServer;
     Session mSession;
     Populator mPopulator;
     Transactions mTxs;
     int mPartitions;
 public:
-    Connection(boost::asio::io_service& service, kudu::client::KuduClient& client, int16_t numWarehouses, int partitions)
-        : mSocket(service)
-        , mServer(*this, mSocket)
+    Connection(boost::asio::io_service& service, kudu::client::KuduClient& client, int16_t numWarehouses, int partitions,
+            bool stockLevelScan)
+        : mStream(service)
+        , mServer(*this, mStream)
         , mSession(client.NewSession())
-        , mTxs(numWarehouses)
+        , mTxs(numWarehouses, stockLevelScan)
         , mPartitions(partitions)
     {
         assertOk(mSession->SetFlushMode(kudu::client::KuduSession::MANUAL_FLUSH));
         mSession->SetTimeoutMillis(60000);
     }
     ~Connection() = default;
-    decltype(mSocket)& socket() { return mSocket; }
+    TransportStream& stream() { return mStream; }
     void run() {
         mServer.run();
     }
@@ -137,16 +138,13 @@ public:
     }
 };
 
-void accept(io_service& service, ip::tcp::acceptor& a, kudu::client::KuduClient& client, int16_t numWarehouses, int partitions) {
-    auto conn = new Connection(service, client, numWarehouses, partitions);
-    a.async_accept(conn->socket(), [&, conn, numWarehouses, partitions](const boost::system::error_code& err) {
-        if (err) {
-            delete conn;
-            LOG_ERROR(err.message());
-            return;
-        }
+void accept(io_service& service, Listener& listener, kudu::client::KuduClient& client, int16_t numWarehouses,
+        int partitions, bool stockLevelScan) {
+    listener.accept([&service, &client, numWarehouses, partitions, stockLevelScan](
+                std::unique_ptr<Transport> transport) {
+        auto conn = new Connection(service, client, numWarehouses, partitions, stockLevelScan);
+        conn->stream().reset(std::move(transport));
         conn->run();
-        accept(service, a, client, numWarehouses, partitions);
     });
 }
 
@@ -161,14 +159,20 @@ int main(int argc, const char* argv[]) {
     int16_t numWarehouses = 0;
     unsigned numThreads = 1;
     int partitions = -1;
+    bool stockLevelScan = false;
+    bool ioUring = false;
     auto opts = create_options("tpcc_server",
             value<'h'>("help", &help, tag::description{"print help"}),
-            value<'H'>("host", &host, tag::description{"Host to bind to"}),
+            value<'H'>("host", &host, tag::description{"Host to bind to, unix:<path> or shm:<path> for local clients"}),
             value<'p'>("port", &port, tag::description{"Port to bind to"}),
             value<'P'>("partitions", &partitions, tag::description{"Number of partitions per table"}),
             value<'l'>("log-level", &logLevel, tag::description{"The log level"}),
             value<'s'>("storage-nodes", &storageNodes, tag::description{"Semicolon-separated list of storage node addresses"}),
             value<'W'>("num-warehouses", &numWarehouses, tag::description{"Number of warehouses"}),
+            value<-1>("io-uring", &ioUring, tag::ignore_short<true>{},
+                tag::description{"Handle client connections with io_uring (if built with USE_IO_URING)"}),
+            value<-1>("stock-level-scan", &stockLevelScan, tag::ignore_short<true>{},
+                tag::description{"Run StockLevel as one order-line range scan and one stock scan"}),
             value<-1>("network-threads", &numThreads, tag::ignore_short<true>{})
             );
     try {
@@ -195,42 +199,17 @@ int main(int argc, const char* argv[]) {
     try {
         io_service service;
         boost::asio::io_service::work work(service);
-        ip::tcp::acceptor a(service);
-        boost::asio::ip::tcp::acceptor::reuse_address option(true);
-        ip::tcp::resolver resolver(service);
-        ip::tcp::resolver::iterator iter;
-        if (host == "") {
-            iter = resolver.resolve(ip::tcp::resolver::query(port));
-        } else {
-            iter = resolver.resolve(ip::tcp::resolver::query(host, port));
-        }
-        ip::tcp::resolver::iterator end;
-        for (; iter != end; ++iter) {
-            boost::system::error_code err;
-            auto endpoint = iter->endpoint();
-            auto protocol = iter->endpoint().protocol();
-            a.open(protocol);
-            a.set_option(option);
-            a.bind(endpoint, err);
-            if (err) {
-                a.close();
-                LOG_WARN("Bind attempt failed " + err.message());
-                continue;
-            }
-            break;
+        tpcc::Listener listener(service, host, port);
+        if (ioUring && !listener.enableIoUring()) {
+            LOG_WARN("io_uring is not available, using the Asio network path");
         }
-        if (!a.is_open()) {
-            LOG_ERROR("Could not bind");
-            return 1;
-        }
-        a.listen();
         // Connect to Kudu
         kudu::client::KuduClientBuilder clientBuilder;
         clientBuilder.add_master_server_addr(storageNodes.c_str());
         std::tr1::shared_ptr<kudu::client::KuduClient> client;
         tpcc::assertOk(clientBuilder.Build(&client));
         // we do not need to delete this object, it will delete itself
-        tpcc::accept(service, a, *client, numWarehouses, partitions);
+        tpcc::accept(service, listener, *client, numWarehouses, partitions, stockLevelScan);
         std::vector<std::thread> threads;
         for (unsigned i = 0; i < numThreads; ++i) {
             threads.emplace_back([&service](){
@@ -242,5 +221,6 @@ int main(int argc, const char* argv[]) {
         }
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
+        return 1;
     }
 }
@@ -20,7 +20,10 @@
  *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
  *     Lucas Braun <braunl@inf.ethz.ch>
  */
+#include "AdmissionControl.hpp"
 #include "Connection.hpp"
+#include "CreateSchema.hpp"
+#include "DeliveryQueue.hpp"
 #include <crossbow/allocator.hpp>
 #include <crossbow/program_options.hpp>
 #include <crossbow/logger.hpp>
@@ -34,18 +37,18 @@ using namespace crossbow::program_options;
 using namespace boost::asio;
 
 void accept(boost::asio::io_service &service,
-        boost::asio::ip::tcp::acceptor &a,
+        tpcc::Listener &listener,
         tell::db::ClientManager<void>& clientManager,
-        int16_t numWarehouses) {
-    auto conn = new tpcc::Connection(service, clientManager, numWarehouses);
-    a.async_accept(conn->socket(), [conn, &service, &a, &clientManager, numWarehouses](const boost::system::error_code &err) {
-        if (err) {
-            delete conn;
-            LOG_ERROR(err.message());
-            return;
-        }
+        int16_t numWarehouses,
+        bool stockLevelScan,
+        tpcc::DeliveryQueue* deliveryQueue,
+        tpcc::AdmissionControl* admission) {
+    listener.accept([&service, &clientManager, numWarehouses, stockLevelScan, deliveryQueue, admission](
+                std::unique_ptr<tpcc::Transport> transport) {
+        auto conn = new tpcc::Connection(service, clientManager, numWarehouses, stockLevelScan, deliveryQueue,
+                admission);
+        conn->stream().reset(std::move(transport));
         conn->run();
-        accept(service, a, clientManager, numWarehouses);
     });
 }
 
@@ -58,13 +61,43 @@ int main(int argc, const char** argv) {
 
     tell::store::ClientConfig config;
     int16_t numWarehouses = 0;
+    bool stockLevelScan = false;
+    bool ioUring = false;
+    bool deferredDelivery = false;
+    size_t deliveryQueueSize = 1000;
+    unsigned deliveryFibers = 4;
+    std::string deliveryLog("delivery.csv");
+    size_t maxInflight = 0;
+    size_t admissionQueueSize = 1000;
+    double shortShare = 1.0;
+    double longShare = 0.25;
     auto opts = create_options("tpcc_server",
             value<'h'>("help", &help, tag::description{"print help"}),
-            value<'H'>("host", &host, tag::description{"Host to bind to"}),
+            value<'H'>("host", &host, tag::description{"Host to bind to, unix:<path> or shm:<path> for local clients"}),
             value<'p'>("port", &port, tag::description{"Port to bind to"}),
             value<'l'>("log-level", &logLevel, tag::description{"The log level"}),
             value<'c'>("commit-manager", &commitManager, tag::description{"Address to the commit manager"}),
             value<'W'>("num-warehouses", &numWarehouses, tag::description{"Number of warehouses"}),
+            value<-1>("io-uring", &ioUring, tag::ignore_short<true>{},
+                tag::description{"Handle client connections with io_uring (if built with USE_IO_URING)"}),
+            value<-1>("stock-level-scan", &stockLevelScan, tag::ignore_short<true>{},
+                tag::description{"Run StockLevel as a range scan over the order-line index (created with the schema)"}),
+            value<-1>("deferred-delivery", &deferredDelivery, tag::ignore_short<true>{},
+                tag::description{"Acknowledge deliveries immediately and execute them in the background"}),
+            value<-1>("delivery-queue-size", &deliveryQueueSize, tag::ignore_short<true>{},
+                tag::description{"Maximum number of queued deferred deliveries"}),
+            value<-1>("delivery-fibers", &deliveryFibers, tag::ignore_short<true>{},
+                tag::description{"Number of fibers executing deferred deliveries"}),
+            value<-1>("delivery-log", &deliveryLog, tag::ignore_short<true>{},
+                tag::description{"Result file for deferred deliveries"}),
+            value<-1>("max-inflight", &maxInflight, tag::ignore_short<true>{},
+                tag::description{"Upper bound of the adaptive limit on running transactions, 0 disables admission control"}),
+            value<-1>("admission-queue-size", &admissionQueueSize, tag::ignore_short<true>{},
+                tag::description{"Maximum number of transactions per priority class waiting for admission before the server rejects them"}),
+            value<-1>("short-share", &shortShare, tag::ignore_short<true>{},
+                tag::description{"Share of the admission limit NewOrder, Payment and OrderStatus may occupy"}),
+            value<-1>("long-share", &longShare, tag::ignore_short<true>{},
+                tag::description{"Share of the admission limit Delivery and StockLevel may occupy"}),
             value<-1>("network-threads", &config.numNetworkThreads, tag::ignore_short<true>{})
             );
     try {
@@ -82,49 +115,52 @@ int main(int argc, const char** argv) {
         std::cerr << "Number of warehouses needs to be set" << std::endl;
         return 1;
     }
+    if (shortShare <= 0.0 || shortShare > 1.0 || longShare <= 0.0 || longShare > 1.0) {
+        std::cerr << "Shares of the admission limit need to be in (0, 1]" << std::endl;
+        return 1;
+    }
 
     crossbow::allocator::init();
 
     crossbow::logger::logger->config.level = crossbow::logger::logLevelFromString(logLevel);
     config.commitManager = config.parseCommitManager(commitManager);
     tell::db::ClientManager<void> clientManager(config);
+    if (stockLevelScan) {
+        bool indexed = true;
+        auto check = clientManager.startTransaction([&indexed](tell::db::Transaction& tx) {
+            indexed = tpcc::hasOrderLineIndex(tx);
+            tx.rollback();
+        }, tell::store::TransactionType::READ_ONLY);
+        check.wait();
+        if (!indexed) {
+            std::cerr << "--stock-level-scan needs the order-line-idx index, which only a server started with "
+                "--stock-level-scan creates with the schema" << std::endl;
+            return 1;
+        }
+    }
 
     try {
         io_service service;
         boost::asio::io_service::work work(service);
-        ip::tcp::acceptor a(service);
-        boost::asio::ip::tcp::acceptor::reuse_address option(true);
-        ip::tcp::resolver resolver(service);
-        ip::tcp::resolver::iterator iter;
-        if (host == "") {
-            iter = resolver.resolve(ip::tcp::resolver::query(port));
-        } else {
-            iter = resolver.resolve(ip::tcp::resolver::query(host, port));
+        tpcc::Listener listener(service, host, port);
+        if (ioUring && !listener.enableIoUring()) {
+            LOG_WARN("io_uring is not available, using the Asio network path");
         }
-        ip::tcp::resolver::iterator end;
-        for (; iter != end; ++iter) {
-            boost::system::error_code err;
-            auto endpoint = iter->endpoint();
-            auto protocol = iter->endpoint().protocol();
-            a.open(protocol);
-            a.set_option(option);
-            a.bind(endpoint, err);
-            if (err) {
-                a.close();
-                LOG_WARN("Bind attempt failed " + err.message());
-                continue;
-            }
-            break;
+        std::unique_ptr<tpcc::DeliveryQueue> deliveryQueue;
+        if (deferredDelivery) {
+            deliveryQueue.reset(new tpcc::DeliveryQueue(service, clientManager, numWarehouses,
+                        deliveryQueueSize, deliveryFibers, deliveryLog));
         }
-        if (!a.is_open()) {
-            LOG_ERROR("Could not bind");
-            return 1;
+        std::unique_ptr<tpcc::AdmissionControl> admission;
+        if (maxInflight > 0) {
+            admission.reset(new tpcc::AdmissionControl(maxInflight, admissionQueueSize, shortShare, longShare));
         }
-        a.listen();
         // we do not need to delete this object, it will delete itself
-        accept(service, a, clientManager, numWarehouses);
+        accept(service, listener, clientManager, numWarehouses, stockLevelScan, deliveryQueue.get(),
+                admission.get());
         service.run();
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
+        return 1;
     }
 }